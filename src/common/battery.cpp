@@ -0,0 +1,34 @@
+#include "battery.h"
+
+#include <algorithm>
+
+Battery::Battery(int level, MonotonicClock::duration step, time_point now)
+    : base_level_(level), base_time_(now), step_(step) {}
+
+auto Battery::Level(time_point now) const -> int {
+    const auto steps = static_cast<int>((now - base_time_) / step_);
+    const int level = charging_ ? base_level_ + steps : base_level_ - steps;
+    return std::clamp(level, min_level_, max_level_);
+}
+
+void Battery::SetCharging(bool charging, time_point now) {
+    if (charging == charging_) {
+        return;
+    }
+    // rebased on the last step, the next one comes when it would have
+    const auto steps = (now - base_time_) / step_;
+    base_level_ = Level(now);
+    base_time_ += steps * step_;
+    charging_ = charging;
+}
+
+auto Battery::ReachesAt(int level, time_point now) const
+    -> std::optional<time_point> {
+    const int current = Level(now);
+    if (level < min_level_ || level > max_level_ ||
+        (charging_ ? level <= current : level >= current)) {
+        return std::nullopt;
+    }
+    const int distance = charging_ ? level - base_level_ : base_level_ - level;
+    return base_time_ + distance * step_;
+}
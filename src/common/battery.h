@@ -0,0 +1,36 @@
+#pragma once
+
+#include <optional>
+
+#include "clock.h"
+
+// Battery level derived from when it last started charging or draining,
+// instead of being ticked. The level moves by one percent every `step`, on
+// the same grid whether or not anyone looks, so a reader computes it on
+// demand and a drone only needs to wake up at the levels it acts on.
+class Battery {
+  public:
+    using time_point = MonotonicClock::time_point;
+
+    static constexpr int min_level_ = 0;
+    static constexpr int max_level_ = 100;
+
+    Battery(int level, MonotonicClock::duration step, time_point now);
+
+    [[nodiscard]] auto Level(time_point now) const -> int;
+    [[nodiscard]] auto Charging() const -> bool {
+        return charging_;
+    }
+    void SetCharging(bool charging, time_point now);
+
+    // When the battery gets to `level` on its current course, none if it
+    // is not ahead of the current one.
+    [[nodiscard]] auto ReachesAt(int level, time_point now) const
+        -> std::optional<time_point>;
+
+  private:
+    int base_level_;
+    time_point base_time_;
+    MonotonicClock::duration step_;
+    bool charging_ = false;
+};
@@ -0,0 +1,110 @@
+#include "command_channel.h"
+
+#include <unistd.h>
+
+#include <chrono>
+#include <utility>
+
+#include "thread.h"
+
+using std::expected, std::unexpected;
+
+namespace {
+auto TypeFor(pid_t pid) -> MessageTypeId {
+    return static_cast<MessageTypeId>(pid);
+}
+}  // namespace
+
+CommandChannel::CommandChannel(IpcMessageQueue queue)
+    : queue_(std::move(queue)), pid_(getpid()) {}
+
+auto CommandChannel::Create(unsigned int permissions)
+    -> expected<CommandChannel, IpcError> {
+    auto queue = IpcMessageQueue::Create(MsgQueueKey::COMMANDS, permissions);
+    if (!queue) {
+        return unexpected(queue.error());
+    }
+    return CommandChannel(std::move(*queue));
+}
+
+auto CommandChannel::Get() -> expected<CommandChannel, IpcError> {
+    auto queue = IpcMessageQueue::Get(MsgQueueKey::COMMANDS);
+    if (!queue) {
+        return unexpected(queue.error());
+    }
+    return CommandChannel(std::move(*queue));
+}
+
+auto CommandChannel::Send(pid_t drone, CommandType type, int64_t arg,
+                          bool wait) -> expected<uint32_t, IpcError> {
+    const Command command{
+        .id = next_id_, .type = type, .arg = arg, .reply_to = pid_};
+    auto sent = queue_.Send(command, TypeFor(drone), wait);
+    if (!sent) {
+        return unexpected(sent.error());
+    }
+    return next_id_++;
+}
+
+auto CommandChannel::SendAll(std::span<const pid_t> drones, CommandType type,
+                             int64_t arg, std::vector<CommandAck>& acks)
+    -> expected<void, IpcError> {
+    using namespace std::chrono_literals;
+
+    for (const auto drone : drones) {
+        while (true) {
+            auto sent = Send(drone, type, arg, false);
+            if (sent) {
+                break;
+            }
+            const auto error = sent.error().code();
+            if (error != std::errc::resource_unavailable_try_again) {
+                return unexpected(sent.error());
+            }
+
+            // the queue is full, acks are the part we can make room with,
+            // blocking in msgsnd could deadlock with drones blocked on acks
+            auto ack = ReceiveAck(false);
+            if (ack) {
+                acks.push_back(*ack);
+                continue;
+            }
+            if (ack.error().code() != std::errc::no_message) {
+                return unexpected(ack.error());
+            }
+            if (!Thread::SleepFor(1ms)) {
+                return unexpected(
+                    IpcError(IpcType::MESSAGE_QUEUE, -1, -1, EINTR));
+            }
+        }
+    }
+    return {};
+}
+
+auto CommandChannel::ReceiveAck(bool wait) -> expected<CommandAck, IpcError> {
+    return queue_.Receive<CommandAck>(TypeFor(pid_), wait);
+}
+
+auto CommandChannel::Discard(pid_t drone) -> expected<size_t, IpcError> {
+    size_t dropped = 0;
+    while (true) {
+        auto command = queue_.Receive<Command>(TypeFor(drone), false);
+        if (!command) {
+            if (command.error().code() == std::errc::no_message) {
+                return dropped;
+            }
+            return unexpected(command.error());
+        }
+        ++dropped;
+    }
+}
+
+auto CommandChannel::ReceiveCommand(bool wait) -> expected<Command, IpcError> {
+    return queue_.Receive<Command>(TypeFor(pid_), wait);
+}
+
+auto CommandChannel::Acknowledge(const Command& command, CommandStatus status)
+    -> expected<void, IpcError> {
+    const CommandAck ack{.id = command.id, .drone = pid_, .status = status};
+    return queue_.Send(ack, TypeFor(command.reply_to));
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <csignal>
+#include <cstdint>
+#include <expected>
+#include <span>
+#include <vector>
+
+#include "ipc/msg_queue.h"
+
+// NOLINTNEXTLINE(performance-enum-size)
+enum class CommandType : uint8_t { SUICIDE };
+
+// Real-time signal carrying `type` for commanders that signal instead of
+// using the channel, sent with Process::Signal(signal, order id).
+inline auto CommandSignal(CommandType type) -> int {
+    return SIGRTMIN + static_cast<int>(type);
+}
+
+// NOLINTNEXTLINE(performance-enum-size)
+enum class CommandStatus : uint8_t { ACCEPTED, REJECTED, UNKNOWN };
+
+struct Command {
+    uint32_t id;
+    CommandType type;
+    int64_t arg;
+    pid_t reply_to;
+};
+
+struct CommandAck {
+    uint32_t id;
+    pid_t drone;
+    CommandStatus status;
+};
+
+// Commander to drone orders over one shared message queue. Commands are
+// sent with the drone's pid as message type and acknowledged with the
+// commander's pid as type, so every process only receives what is meant
+// for it. Unlike signals, orders queue up, carry a payload and are never
+// merged.
+//
+// Drones and the commander share the queue's capacity: a commander that
+// stops reading acks eventually blocks drones acknowledging. SendAll
+// collects acks while it waits for room.
+class CommandChannel {
+  public:
+    [[nodiscard]]
+    static auto Create(unsigned int permissions)
+        -> std::expected<CommandChannel, IpcError>;
+    [[nodiscard]]
+    static auto Get() -> std::expected<CommandChannel, IpcError>;
+
+    // Returns the id the drone will acknowledge.
+    [[nodiscard]]
+    auto Send(pid_t drone, CommandType type, int64_t arg = 0,
+              bool wait = true) -> std::expected<uint32_t, IpcError>;
+    // Sends the command to every drone, appending the acks that arrive
+    // meanwhile to `acks`.
+    [[nodiscard]]
+    auto SendAll(std::span<const pid_t> drones, CommandType type,
+                 int64_t arg, std::vector<CommandAck>& acks)
+        -> std::expected<void, IpcError>;
+    [[nodiscard]]
+    auto ReceiveAck(bool wait = true) -> std::expected<CommandAck, IpcError>;
+    // Drops the commands still queued for a drone that died, before its pid
+    // can be reused by a process that would take them. Returns how many.
+    [[nodiscard]]
+    auto Discard(pid_t drone) -> std::expected<size_t, IpcError>;
+
+    // Drone side, receives commands sent to this process.
+    [[nodiscard]]
+    auto ReceiveCommand(bool wait = true) -> std::expected<Command, IpcError>;
+    [[nodiscard]]
+    auto Acknowledge(const Command& command, CommandStatus status)
+        -> std::expected<void, IpcError>;
+
+  private:
+    explicit CommandChannel(IpcMessageQueue queue);
+
+    IpcMessageQueue queue_;
+    pid_t pid_;
+    uint32_t next_id_ = 1;
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <chrono>
+
+// Rules every drone follows, whether it runs as its own process or as an
+// entity in the swarm engine.
+
+constexpr int g_ignore_suicide_bat_thr = 20;
+constexpr int g_low_bat_thr = 20;
+constexpr int g_max_charges = 2;
+constexpr int g_initial_bat_level = 50;
+constexpr int g_full_bat_level = 100;
+// time per percent of charge, either way
+constexpr auto g_bat_step = std::chrono::milliseconds(50);
+constexpr auto g_base_flight_time = std::chrono::milliseconds(500);
+
+// In flight, heading back to the base to charge.
+constexpr auto ShouldReturn(int bat_level, bool suicide_order) -> bool {
+    return bat_level < g_low_bat_thr && !suicide_order;
+}
+
+// Docked, taking off again.
+constexpr auto ShouldLeave(int bat_level, bool suicide_order) -> bool {
+    return bat_level >= g_full_bat_level || suicide_order;
+}
+
+constexpr auto AcceptsSuicideOrder(int bat_level) -> bool {
+    return bat_level >= g_ignore_suicide_bat_thr;
+}
+
+// Checked on arrival at the base.
+constexpr auto ShouldDecommission(int charges) -> bool {
+    return charges >= g_max_charges;
+}
@@ -0,0 +1,101 @@
+#include "drone_state.h"
+
+#include <cerrno>
+#include <cstddef>
+
+using std::expected, std::unexpected;
+
+auto DroneStateTable::Create(SharedArena& arena, size_t capacity)
+    -> expected<DroneStateTable*, IpcError> {
+    auto table = arena.New<DroneStateTable>();
+    if (!table) {
+        return unexpected(table.error());
+    }
+
+    auto column = [&]<typename T>(Column<T>& target) -> bool {
+        auto array = arena.NewArray<std::atomic<T>>(capacity);
+        if (array) {
+            target = array->data();
+        }
+        return static_cast<bool>(array);
+    };
+    auto* created = *table;
+    if (!column(created->pid_) || !column(created->bat_level_) ||
+        !column(created->charges_) || !column(created->docked_) ||
+        !column(created->suicide_order_)) {
+        return unexpected(IpcError(IpcType::SHARED_MEMORY, -1, -1, ENOMEM));
+    }
+    created->capacity_ = capacity;
+
+    return created;
+}
+
+void DroneStateTable::Claim(size_t slot, pid_t pid) {
+    SetBatteryLevel(slot, 0);
+    SetCharges(slot, 0);
+    SetDocked(slot, false);
+    SetSuicideOrder(slot, false);
+    pid_.Get()[slot].store(pid, std::memory_order_release);
+}
+
+void DroneStateTable::Release(size_t slot) {
+    pid_.Get()[slot].store(0, std::memory_order_release);
+}
+
+auto DroneStateTable::SuicideCandidates(int min_bat_level,
+                                        std::span<uint32_t> slots) const
+    -> size_t {
+    size_t found = 0;
+    const auto* pids = pid_.Get();
+    const auto* bat_level = bat_level_.Get();
+    const auto* docked = docked_.Get();
+    const auto* suicide_order = suicide_order_.Get();
+    for (size_t slot = 0; slot < capacity_ && found < slots.size(); ++slot) {
+        if (bat_level[slot].load(std::memory_order_relaxed) >= min_bat_level &&
+            !docked[slot].load(std::memory_order_relaxed) &&
+            !suicide_order[slot].load(std::memory_order_relaxed) &&
+            pids[slot].load(std::memory_order_relaxed) != 0) {
+            slots[found++] = static_cast<uint32_t>(slot);
+        }
+    }
+    return found;
+}
+
+auto SwarmState::Create(size_t capacity, unsigned int permissions)
+    -> expected<SwarmState, IpcError> {
+    // the table and its columns, each of them possibly needing alignment
+    constexpr size_t pieces = 6;
+    const auto size = sizeof(DroneStateTable) +
+                      capacity * (sizeof(pid_t) + 2 * sizeof(uint8_t) +
+                                  2 * sizeof(bool)) +
+                      pieces * alignof(std::max_align_t);
+    auto arena =
+        SharedArena::Create(SharedMemoryKey::SWARM_STATE, size, permissions);
+    if (!arena) {
+        return unexpected(arena.error());
+    }
+
+    auto table = DroneStateTable::Create(*arena, capacity);
+    if (!table) {
+        return unexpected(table.error());
+    }
+    arena->SetRoot(*table);
+
+    return SwarmState(std::move(*arena), *table);
+}
+
+auto SwarmState::Get() -> expected<SwarmState, IpcError> {
+    auto arena = SharedArena::Get(SharedMemoryKey::SWARM_STATE);
+    if (!arena) {
+        return unexpected(arena.error());
+    }
+
+    auto* table = arena->Root<DroneStateTable>();
+    if (table == nullptr) {
+        return unexpected(
+            IpcError(IpcType::SHARED_MEMORY,
+                     IpcRun::Key(SharedMemoryKey::SWARM_STATE), -1, EAGAIN));
+    }
+
+    return SwarmState(std::move(*arena), table);
+}
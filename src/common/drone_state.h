@@ -0,0 +1,109 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <span>
+
+#include "ipc/ipc.h"
+#include "ipc/shared_arena.h"
+
+// Swarm-wide view of every drone's state, one slot per drone. Each field
+// is its own array, so scans over one field (how many are docked, who has
+// battery left) walk contiguous memory. Drones publish with relaxed atomic
+// stores to their own slot, readers get a recent but not a consistent
+// snapshot across fields.
+class DroneStateTable {
+  public:
+    [[nodiscard]]
+    static auto Create(SharedArena& arena, size_t capacity)
+        -> std::expected<DroneStateTable*, IpcError>;
+
+    [[nodiscard]] auto Capacity() const -> size_t {
+        return capacity_;
+    }
+
+    // A slot counts as active while it holds a pid.
+    void Claim(size_t slot, pid_t pid);
+    void Release(size_t slot);
+
+    void SetBatteryLevel(size_t slot, int level) {
+        bat_level_.Get()[slot].store(static_cast<uint8_t>(level),
+                                     std::memory_order_relaxed);
+    }
+    void SetCharges(size_t slot, int charges) {
+        charges_.Get()[slot].store(static_cast<uint8_t>(charges),
+                                   std::memory_order_relaxed);
+    }
+    void SetDocked(size_t slot, bool docked) {
+        docked_.Get()[slot].store(docked, std::memory_order_relaxed);
+    }
+    void SetSuicideOrder(size_t slot, bool received) {
+        suicide_order_.Get()[slot].store(received, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] auto Pid(size_t slot) const -> pid_t {
+        return pid_.Get()[slot].load(std::memory_order_acquire);
+    }
+    [[nodiscard]] auto BatteryLevel(size_t slot) const -> int {
+        return bat_level_.Get()[slot].load(std::memory_order_relaxed);
+    }
+    [[nodiscard]] auto Charges(size_t slot) const -> int {
+        return charges_.Get()[slot].load(std::memory_order_relaxed);
+    }
+    [[nodiscard]] auto Docked(size_t slot) const -> bool {
+        return docked_.Get()[slot].load(std::memory_order_relaxed);
+    }
+    [[nodiscard]] auto SuicideOrder(size_t slot) const -> bool {
+        return suicide_order_.Get()[slot].load(std::memory_order_relaxed);
+    }
+
+    // Fills `slots` with active drones in flight that have no order yet and
+    // at least `min_bat_level` battery, returns how many were written.
+    [[nodiscard]] auto SuicideCandidates(int min_bat_level,
+                                         std::span<uint32_t> slots) const
+        -> size_t;
+
+  private:
+    template <typename T>
+    using Column = OffsetPtr<std::atomic<T>>;
+
+    DroneStateTable() = default;
+
+    size_t capacity_ = 0;
+    Column<pid_t> pid_;
+    Column<uint8_t> bat_level_;
+    Column<uint8_t> charges_;
+    Column<bool> docked_;
+    Column<bool> suicide_order_;
+
+    friend class SharedArena;
+};
+
+// Owns the arena holding the DroneStateTable, sized for `capacity` drones.
+class SwarmState {
+  public:
+    [[nodiscard]]
+    static auto Create(size_t capacity, unsigned int permissions)
+        -> std::expected<SwarmState, IpcError>;
+
+    [[nodiscard]]
+    static auto Get() -> std::expected<SwarmState, IpcError>;
+
+    auto operator->() -> DroneStateTable* {
+        return table_;
+    }
+    auto operator->() const -> const DroneStateTable* {
+        return table_;
+    }
+
+  private:
+    SwarmState(SharedArena arena, DroneStateTable* table)
+        : arena_(std::move(arena)), table_(table) {}
+
+    SharedArena arena_;
+    DroneStateTable* table_;
+};
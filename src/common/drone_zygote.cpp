@@ -0,0 +1,67 @@
+#include "drone_zygote.h"
+
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <array>
+#include <string>
+#include <utility>
+#include <vector>
+
+using std::expected, std::unexpected;
+
+DroneZygote::DroneZygote(Process process, int socket)
+    : process_(std::move(process)),
+      replies_(socket),
+      requests_(dup(socket)) {}
+
+auto DroneZygote::Create(size_t pool_size, bool event_loop)
+    -> expected<DroneZygote, std::system_error> {
+    // drones orphaned by the zygote's middle children come to us
+    if (prctl(PR_SET_CHILD_SUBREAPER, 1) == -1) {
+        return unexpected(std::system_error(errno, std::generic_category()));
+    }
+
+    // one socket both ways, seqpacket keeps requests and replies whole
+    std::array<int, 2> sockets{};
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0,
+                   sockets.data()) == -1) {
+        return unexpected(std::system_error(errno, std::generic_category()));
+    }
+
+    const auto pool = std::to_string(pool_size);
+    std::vector<const char*> args{"./drone", "--zygote", "--pool",
+                                  pool.c_str()};
+    if (event_loop) {
+        args.push_back("--event-loop");
+    }
+    auto process = Process::CreateWithFd(args, sockets[1], g_zygote_fd);
+    close(sockets[1]);
+    if (!process) {
+        close(sockets[0]);
+        return unexpected(process.error());
+    }
+
+    return DroneZygote(std::move(*process), sockets[0]);
+}
+
+auto DroneZygote::Launch(size_t slot) -> expected<Process, std::system_error> {
+    if (auto sent = requests_.Write(ZygoteRequest{.slot = slot}); !sent) {
+        return unexpected(sent.error());
+    }
+    auto reply = replies_.Read<ZygoteReply>();
+    if (!reply) {
+        return unexpected(reply.error());
+    }
+    if (reply->result < 0) {
+        return unexpected(
+            std::system_error(-reply->result, std::generic_category()));
+    }
+
+    return Process::Adopt(reply->result);
+}
+
+auto DroneZygote::Stop() -> expected<int, std::system_error> {
+    return process_.TermWait();
+}
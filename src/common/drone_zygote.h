@@ -0,0 +1,53 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <expected>
+#include <system_error>
+
+#include "process.h"
+
+// Wire format between the operator and `drone --zygote`, over the socket
+// the zygote gets as fd 3.
+struct ZygoteRequest {
+    uint64_t slot;
+};
+
+// pid of the launched drone, or -errno.
+struct ZygoteReply {
+    pid_t result;
+};
+
+constexpr int g_zygote_fd = 3;
+
+// Operator side of a drone zygote: a drone process that has loaded its
+// image, attached the swarm state and created its Logger once, and forks
+// ready drones on request. The zygote forks every drone through a
+// short-lived middle child, and Create makes the operator a child
+// subreaper. The orphaned drones are reparented to the operator, which
+// waits for them like for any Process::Create child. With a pool, the
+// zygote keeps that many drones forked and parked, a launch then only has
+// to wake one up.
+class DroneZygote {
+  public:
+    // With `event_loop` the drones run the single-threaded runtime.
+    [[nodiscard]]
+    static auto Create(size_t pool_size, bool event_loop = false)
+        -> std::expected<DroneZygote, std::system_error>;
+
+    // Starts a drone in swarm state `slot`.
+    [[nodiscard]]
+    auto Launch(size_t slot) -> std::expected<Process, std::system_error>;
+
+    // Stops the zygote, drones still parked exit with it.
+    [[nodiscard]]
+    auto Stop() -> std::expected<int, std::system_error>;
+
+  private:
+    DroneZygote(Process process, int socket);
+
+    Process process_;
+    PipeReader replies_;
+    PipeWriter requests_;
+};
@@ -0,0 +1,184 @@
+#include "event_loop.h"
+
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <utility>
+
+using std::expected, std::unexpected;
+
+namespace {
+auto Errno() -> std::system_error {
+    return {errno, std::generic_category()};
+}
+
+auto ToTimespec(MonotonicClock::duration dur) -> timespec {
+    const auto sec = std::chrono::duration_cast<std::chrono::seconds>(dur);
+    return {.tv_sec = sec.count(), .tv_nsec = (dur - sec).count()};
+}
+
+constexpr size_t g_event_loop_max_events = 16;
+}  // namespace
+
+EventLoop::EventLoop(int epoll_fd) : epoll_fd_(epoll_fd) {}
+
+EventLoop::EventLoop(EventLoop&& other) noexcept
+    : epoll_fd_(other.epoll_fd_),
+      sources_(std::move(other.sources_)),
+      stopped_(other.stopped_) {
+    other.epoll_fd_ = -1;
+    other.sources_.clear();
+}
+
+EventLoop::~EventLoop() {
+    for (const auto& [fd, source] : sources_) {
+        if (source->kind != Kind::FD) {
+            close(fd);
+        }
+    }
+    if (epoll_fd_ != -1) {
+        close(epoll_fd_);
+    }
+}
+
+auto EventLoop::Create() -> expected<EventLoop, std::system_error> {
+    const int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd == -1) {
+        return unexpected(Errno());
+    }
+    return EventLoop(epoll_fd);
+}
+
+auto EventLoop::Add(int fd, Source source)
+    -> expected<void, std::system_error> {
+    epoll_event event{.events = EPOLLIN, .data = {.fd = fd}};
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) == -1) {
+        return unexpected(Errno());
+    }
+    sources_.insert_or_assign(
+        fd, std::make_shared<const Source>(std::move(source)));
+    return {};
+}
+
+auto EventLoop::WatchSignals(const sigset_t& signals, SignalCallback on_signal)
+    -> expected<void, std::system_error> {
+    if (pthread_sigmask(SIG_BLOCK, &signals, nullptr) != 0) {
+        return unexpected(Errno());
+    }
+    const int signal_fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signal_fd == -1) {
+        return unexpected(Errno());
+    }
+
+    auto added = Add(signal_fd, {.kind = Kind::SIGNALS,
+                                 .callback = {},
+                                 .on_signal = std::move(on_signal)});
+    if (!added) {
+        close(signal_fd);
+    }
+    return added;
+}
+
+auto EventLoop::WatchFd(int fd, Callback on_readable)
+    -> expected<void, std::system_error> {
+    return Add(fd, {.kind = Kind::FD,
+                    .callback = std::move(on_readable),
+                    .on_signal = {}});
+}
+
+void EventLoop::Unwatch(int fd) {
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    sources_.erase(fd);
+}
+
+auto EventLoop::AddTimer(Callback on_expiry)
+    -> expected<TimerId, std::system_error> {
+    const int timer_fd =
+        timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd == -1) {
+        return unexpected(Errno());
+    }
+
+    auto added = Add(timer_fd, {.kind = Kind::TIMER,
+                                .callback = std::move(on_expiry),
+                                .on_signal = {}});
+    if (!added) {
+        close(timer_fd);
+        return unexpected(added.error());
+    }
+    return timer_fd;
+}
+
+auto EventLoop::SetTimer(TimerId timer,
+                         std::optional<MonotonicClock::time_point> deadline,
+                         MonotonicClock::duration interval)
+    -> expected<void, std::system_error> {
+    itimerspec spec{};  // zero disarms
+    if (deadline) {
+        spec.it_value = ToTimespec(deadline->time_since_epoch());
+        spec.it_interval = ToTimespec(interval);
+    }
+    if (timerfd_settime(timer, TFD_TIMER_ABSTIME, &spec, nullptr) == -1) {
+        return unexpected(Errno());
+    }
+    return {};
+}
+
+auto EventLoop::Run() -> expected<void, std::system_error> {
+    stopped_ = false;
+    std::array<epoll_event, g_event_loop_max_events> events{};
+    while (!stopped_) {
+        const int ready = epoll_wait(epoll_fd_, events.data(),
+                                     static_cast<int>(events.size()), -1);
+        if (ready == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return unexpected(Errno());
+        }
+
+        for (const auto& event : std::span(events).first(ready)) {
+            if (stopped_) {
+                break;
+            }
+            Dispatch(event.data.fd);
+        }
+    }
+    return {};
+}
+
+void EventLoop::Dispatch(int fd) {
+    const auto found = sources_.find(fd);
+    if (found == sources_.end()) {
+        return;  // unwatched by an earlier callback
+    }
+    const auto source = found->second;
+
+    switch (source->kind) {
+        case Kind::FD:
+            source->callback();
+            break;
+        case Kind::SIGNALS: {
+            signalfd_siginfo info{};
+            while (read(fd, &info, sizeof(info)) == sizeof(info)) {
+                source->on_signal(info);
+            }
+            break;
+        }
+        case Kind::TIMER: {
+            uint64_t expirations{};
+            // a re-armed timer may have nothing to read any more
+            if (read(fd, &expirations, sizeof(expirations)) ==
+                sizeof(expirations)) {
+                source->callback();
+            }
+            break;
+        }
+    }
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <sys/signalfd.h>
+
+#include <chrono>
+#include <csignal>
+#include <expected>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <system_error>
+#include <unordered_map>
+
+#include "clock.h"
+
+// Runs a process's work on one thread: signals through a signalfd, timers
+// through timerfds and any other readable fd, all waited for in one epoll
+// set. Callbacks run on the thread calling Run and may add, re-arm or
+// Stop.
+class EventLoop {
+  public:
+    using Callback = std::function<void()>;
+    using SignalCallback = std::function<void(const signalfd_siginfo&)>;
+    using TimerId = int;
+
+    EventLoop(EventLoop&& other) noexcept;
+    EventLoop(const EventLoop&) = delete;
+    auto operator=(EventLoop&&) -> EventLoop& = delete;
+    auto operator=(const EventLoop&) -> EventLoop& = delete;
+    ~EventLoop();
+
+    [[nodiscard]]
+    static auto Create() -> std::expected<EventLoop, std::system_error>;
+
+    // Blocks `signals` in the calling thread, they are only delivered here.
+    // Call once, before other threads are started.
+    [[nodiscard]]
+    auto WatchSignals(const sigset_t& signals, SignalCallback on_signal)
+        -> std::expected<void, std::system_error>;
+
+    // `fd` stays the caller's to close, after it is no longer watched.
+    [[nodiscard]]
+    auto WatchFd(int fd, Callback on_readable)
+        -> std::expected<void, std::system_error>;
+    void Unwatch(int fd);
+
+    // Starts disarmed.
+    [[nodiscard]]
+    auto AddTimer(Callback on_expiry)
+        -> std::expected<TimerId, std::system_error>;
+    // Replaces the timer's deadline, none disarms it. With an `interval` it
+    // keeps expiring that often after the deadline.
+    [[nodiscard]]
+    auto SetTimer(TimerId timer,
+                  std::optional<MonotonicClock::time_point> deadline,
+                  MonotonicClock::duration interval = {})
+        -> std::expected<void, std::system_error>;
+
+    // Dispatches until Stop.
+    [[nodiscard]]
+    auto Run() -> std::expected<void, std::system_error>;
+    void Stop() {
+        stopped_ = true;
+    }
+
+  private:
+    // NOLINTNEXTLINE(performance-enum-size)
+    enum class Kind : uint8_t { FD, SIGNALS, TIMER };
+
+    struct Source {
+        Kind kind;
+        Callback callback;
+        SignalCallback on_signal;
+    };
+
+    explicit EventLoop(int epoll_fd);
+
+    auto Add(int fd, Source source) -> std::expected<void, std::system_error>;
+    void Dispatch(int fd);
+
+    int epoll_fd_;
+    // by fd, signalfd and timerfds are owned. Shared so a callback that
+    // unwatches its own fd keeps running.
+    std::unordered_map<int, std::shared_ptr<const Source>> sources_;
+    bool stopped_ = false;
+};
@@ -0,0 +1,33 @@
+#include "futex.h"
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+auto FutexAddr(std::atomic<uint32_t>& word) -> uint32_t* {
+    return reinterpret_cast<uint32_t*>(&word);
+}
+}  // namespace
+
+auto Futex::Wait(std::atomic<uint32_t>& word, uint32_t expected)
+    -> std::expected<void, std::system_error> {
+    auto result = syscall(SYS_futex, FutexAddr(word), FUTEX_WAIT, expected,
+                          nullptr, nullptr, 0);
+    if (result == -1) {
+        return std::unexpected(
+            std::system_error(errno, std::generic_category()));
+    }
+    return {};
+}
+
+auto Futex::Recheck(const std::system_error& error) -> bool {
+    return error.code() == std::errc::interrupted ||
+           error.code() == std::errc::resource_unavailable_try_again;
+}
+
+auto Futex::Wake(std::atomic<uint32_t>& word, int count) -> int {
+    auto result = syscall(SYS_futex, FutexAddr(word), FUTEX_WAKE, count,
+                          nullptr, nullptr, 0);
+    return result == -1 ? 0 : static_cast<int>(result);
+}
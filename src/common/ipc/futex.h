@@ -0,0 +1,31 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <expected>
+#include <system_error>
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t) &&
+                  std::atomic<uint32_t>::is_always_lock_free,
+              "futex words must be plain lock-free 32-bit integers");
+
+// Wrappers for futex(2) on words that may live in shared memory. Only the
+// shared (non FUTEX_PRIVATE) operations are used, so waiters in different
+// processes mapping the same segment see each other.
+class Futex {
+  public:
+    // Sleeps while `word` still holds `expected`. Spurious wakeups, EINTR
+    // and EAGAIN (value already changed) are reported as errors so callers
+    // can decide whether to recheck their condition.
+    [[nodiscard]]
+    static auto Wait(std::atomic<uint32_t>& word, uint32_t expected)
+        -> std::expected<void, std::system_error>;
+
+    // True for the Wait errors that only mean the condition must be
+    // rechecked.
+    [[nodiscard]]
+    static auto Recheck(const std::system_error& error) -> bool;
+
+    // Wakes up to `count` waiters, returns how many were woken.
+    static auto Wake(std::atomic<uint32_t>& word, int count) -> int;
+};
@@ -0,0 +1,13 @@
+#include "futex_sync.h"
+
+void FutexMutex::LockSlow(uint32_t state) {
+    // once contended, stay contended until the lock is taken, so the
+    // Unlock that lets us in also wakes whoever sleeps behind us
+    if (state != CONTENDED) {
+        state = state_.exchange(CONTENDED, std::memory_order_acquire);
+    }
+    while (state != UNLOCKED) {
+        auto waited = Futex::Wait(state_, CONTENDED);
+        state = state_.exchange(CONTENDED, std::memory_order_acquire);
+    }
+}
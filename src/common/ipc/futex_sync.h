@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "ipc/futex.h"
+
+// Process-shared, non-recursive mutex with the same calls as ThreadMutex,
+// meant to be placed in a SharedMemory segment. The uncontended path is a
+// single atomic operation, futex(2) is only entered to sleep or to wake
+// someone who sleeps.
+//
+// Unlike System V semaphores nothing is undone when a process dies, so a
+// process killed while holding the mutex leaves it held.
+class FutexMutex {
+  public:
+    FutexMutex() = default;
+    FutexMutex(FutexMutex&&) = delete;
+    FutexMutex(const FutexMutex&) = delete;
+    auto operator=(FutexMutex&&) -> FutexMutex& = delete;
+    auto operator=(const FutexMutex&) -> FutexMutex& = delete;
+    ~FutexMutex() = default;
+
+    void Lock() {
+        uint32_t expected = UNLOCKED;
+        if (!state_.compare_exchange_strong(expected, LOCKED,
+                                            std::memory_order_acquire)) {
+            LockSlow(expected);
+        }
+    }
+
+    [[nodiscard]] auto TryLock() -> bool {
+        uint32_t expected = UNLOCKED;
+        return state_.compare_exchange_strong(expected, LOCKED,
+                                              std::memory_order_acquire);
+    }
+
+    void Unlock() {
+        if (state_.exchange(UNLOCKED, std::memory_order_release) ==
+            CONTENDED) {
+            Futex::Wake(state_, 1);
+        }
+    }
+
+  private:
+    // Drepper's three state mutex: Unlock only pays for FUTEX_WAKE once
+    // someone went to sleep.
+    enum : uint32_t { UNLOCKED, LOCKED, CONTENDED };
+
+    void LockSlow(uint32_t state);
+
+    std::atomic<uint32_t> state_{UNLOCKED};
+};
@@ -3,10 +3,52 @@
 #include <sys/ipc.h>
 #include <sys/msg.h>
 
+#include <cerrno>
+#include <charconv>
+#include <cstdlib>
 #include <format>
+#include <string>
 
 using std::format;
 
+auto IpcRun::Id() -> uint32_t {
+    // read every time, creating IPC objects is rare and SetId may change it
+    const char* value = std::getenv(env_var_);
+    if (value == nullptr) {
+        return 0;
+    }
+    const auto run_id = std::strtoul(value, nullptr, 10);
+    return run_id > max_id_ ? 0 : static_cast<uint32_t>(run_id);
+}
+
+auto IpcRun::Parse(std::string_view text)
+    -> std::expected<uint32_t, std::system_error> {
+    // 0 is the run of processes started without one, not a run to pick
+    uint32_t run_id = 0;
+    const auto* const end = text.data() + text.size();
+    const auto [parsed, error] = std::from_chars(text.data(), end, run_id);
+    if (error != std::errc() || parsed != end || run_id == 0 ||
+        run_id > max_id_) {
+        return std::unexpected(
+            std::system_error(std::make_error_code(std::errc::invalid_argument),
+                              format("invalid run id '{}'", text)));
+    }
+    return run_id;
+}
+
+auto IpcRun::SetId(uint32_t run_id) -> std::expected<void, std::system_error> {
+    if (run_id > max_id_) {
+        return std::unexpected(std::system_error(
+            std::make_error_code(std::errc::result_out_of_range),
+            "run id too large"));
+    }
+    if (setenv(env_var_, std::to_string(run_id).c_str(), 1) == -1) {
+        return std::unexpected(
+            std::system_error(errno, std::generic_category()));
+    }
+    return {};
+}
+
 IpcError::IpcError(IpcType ipc_type, key_t key, int ipc_id, int error)
     : std::system_error(error, std::generic_category(),
                         format("IPC Error in {} key '{}' id '{}'",
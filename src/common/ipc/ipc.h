@@ -1,10 +1,20 @@
 #pragma once
 
+#include <sys/types.h>
+
+#include <climits>
 #include <cstdint>
+#include <expected>
+#include <string_view>
 #include <system_error>
+#include <type_traits>
 
+// Keys below are per run, see IpcRun.
 // NOLINTNEXTLINE(performance-enum-size)
-enum class MsgQueueKey : key_t { MAIN = 33889 };
+enum class MsgQueueKey : key_t {
+    MAIN = 33889,  // MAIN + 1 .. MAIN + 15 hold the other log queue shards
+    COMMANDS = 33905
+};
 
 // NOLINTNEXTLINE(performance-enum-size)
 enum class MessageTypeId : long { LOGGER = 1 };
@@ -13,12 +23,49 @@ enum class MessageTypeId : long { LOGGER = 1 };
 enum class SemaphoreSetKey : key_t { MAIN = 33889 };
 
 // NOLINTNEXTLINE(performance-enum-size)
-enum class SharedMemoryKey : key_t { MAIN = 33889 };
+enum class SharedMemoryKey : key_t {
+    MAIN = 33889,
+    LOGGER = 33890,
+    LOG_LEVELS = 33891,
+    SWARM_STATE = 33892
+};
 
 // NOLINTNEXTLINE(performance-enum-size)
 // enum class TestSem : int { GRACEFUL_EXIT, COUNT };
 
-enum class IpcType : uint8_t { MESSAGE_QUEUE, SEMAPHORE_SET, SHARED_MEMORY };
+// Every simulation run owns its own range of IPC keys, so several runs can
+// share a host. The run id reaches child processes through the
+// DRONE_SWARM_RUN environment variable. Without it the run is 0 and the
+// keys are the plain enum values, so tools like logctl find a lone run.
+class IpcRun {
+  public:
+    static constexpr const char* env_var_ = "DRONE_SWARM_RUN";
+    // keys from 33889 up to 33889 + keys_per_run_ belong to one run
+    static constexpr key_t keys_per_run_ = 64;
+    static constexpr uint32_t max_id_ =
+        (INT_MAX - 40000) / keys_per_run_;  // NOLINT
+
+    [[nodiscard]] static auto Id() -> uint32_t;
+    // Parses a run id given on a command line, a decimal from 1 to max_id_.
+    [[nodiscard]] static auto Parse(std::string_view text)
+        -> std::expected<uint32_t, std::system_error>;
+    // Also exported to processes started afterwards.
+    [[nodiscard]] static auto SetId(uint32_t run_id)
+        -> std::expected<void, std::system_error>;
+
+    template <typename E>
+        requires std::is_enum_v<E>
+    [[nodiscard]] static auto Key(E key) -> key_t {
+        return static_cast<key_t>(key) +
+               static_cast<key_t>(Id()) * keys_per_run_;
+    }
+};
+
+enum class IpcType : uint8_t {
+    MESSAGE_QUEUE,
+    SEMAPHORE_SET,
+    SHARED_MEMORY
+};
 
 class IpcError : public std::system_error {
   public:
@@ -0,0 +1,243 @@
+#include "ipc_registry.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/msg.h>
+#include <sys/sem.h>
+#include <sys/shm.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <format>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+struct Entry {
+    int type;
+    key_t key;
+    int ipc_id;
+    pid_t creator;
+};
+
+auto Error(std::string_view what) -> std::system_error {
+    return {errno, std::generic_category(), std::string(what)};
+}
+
+// Creates the user's registry directory if needed. Refuses one that is
+// not a directory of ours closed to everyone else, someone could have
+// planted it in /tmp.
+auto RegistryDir(bool create) -> std::expected<std::string, std::system_error> {
+    const char* runtime_dir = std::getenv("XDG_RUNTIME_DIR");
+    auto dir = runtime_dir != nullptr && *runtime_dir != '\0'
+                   ? std::format("{}/drone-swarm-ipc", runtime_dir)
+                   : std::format("/tmp/drone-swarm-ipc-{}", getuid());
+
+    if (create && mkdir(dir.c_str(), 0700) == -1 && errno != EEXIST) {
+        return std::unexpected(Error(dir));
+    }
+    struct stat dir_stat{};
+    if (lstat(dir.c_str(), &dir_stat) == -1) {
+        return std::unexpected(Error(dir));
+    }
+    if (!S_ISDIR(dir_stat.st_mode) || dir_stat.st_uid != getuid() ||
+        (dir_stat.st_mode & 077) != 0) {  // NOLINT
+        return std::unexpected(std::system_error(
+            std::make_error_code(std::errc::permission_denied),
+            std::format("{} is not a private directory", dir)));
+    }
+    return dir;
+}
+
+auto CreatorAlive(pid_t pid) -> bool {
+    // EPERM means someone else's live process took the pid
+    return kill(pid, 0) == 0 || errno != ESRCH;
+}
+
+// The permissions of the object the id names if it was created under
+// `key`. Ids are reused once an object is removed, the key tells the new
+// owner apart.
+auto Lookup(const Entry& entry) -> std::optional<ipc_perm> {
+    const auto matching = [&](const ipc_perm& perm) -> std::optional<ipc_perm> {
+        if (perm.__key != entry.key) {
+            return std::nullopt;
+        }
+        return perm;
+    };
+    switch (static_cast<IpcType>(entry.type)) {
+        case IpcType::MESSAGE_QUEUE: {
+            msqid_ds stat{};
+            if (msgctl(entry.ipc_id, IPC_STAT, &stat) == 0) {
+                return matching(stat.msg_perm);
+            }
+            break;
+        }
+        case IpcType::SEMAPHORE_SET: {
+            semid_ds stat{};
+            if (semctl(entry.ipc_id, 0, IPC_STAT, &stat) == 0) {
+                return matching(stat.sem_perm);
+            }
+            break;
+        }
+        case IpcType::SHARED_MEMORY: {
+            shmid_ds stat{};
+            if (shmctl(entry.ipc_id, IPC_STAT, &stat) == 0) {
+                return matching(stat.shm_perm);
+            }
+            break;
+        }
+    }
+    return std::nullopt;
+}
+
+auto RemoveObject(const Entry& entry) -> bool {
+    switch (static_cast<IpcType>(entry.type)) {
+        case IpcType::MESSAGE_QUEUE:
+            return msgctl(entry.ipc_id, IPC_RMID, nullptr) == 0;
+        case IpcType::SEMAPHORE_SET:
+            return semctl(entry.ipc_id, 0, IPC_RMID) == 0;
+        case IpcType::SHARED_MEMORY:
+            // attached processes keep the segment until they detach
+            return shmctl(entry.ipc_id, IPC_RMID, nullptr) == 0;
+    }
+    return false;
+}
+
+auto ReadEntries(std::FILE* file) -> std::vector<Entry> {
+    std::vector<Entry> entries;
+    Entry entry{};
+    while (std::fscanf(file, "%d %d %d %d", &entry.type, &entry.key,
+                       &entry.ipc_id, &entry.creator) == 4) {
+        entries.push_back(entry);
+    }
+    return entries;
+}
+
+// Reclaims one run file, keeps only the records of live creators. Files
+// that aren't regular files of ours are skipped.
+auto ReclaimFile(const std::string& path, size_t& removed)
+    -> std::expected<void, std::system_error> {
+    const int fd = open(path.c_str(), O_RDWR | O_NOFOLLOW | O_CLOEXEC);
+    if (fd == -1) {
+        // another reclaim pass may have just deleted it
+        if (errno == ENOENT || errno == ELOOP || errno == EACCES) {
+            return {};
+        }
+        return std::unexpected(Error(path));
+    }
+    struct stat file_stat{};
+    if (fstat(fd, &file_stat) == -1 || !S_ISREG(file_stat.st_mode) ||
+        file_stat.st_uid != getuid()) {
+        close(fd);
+        return {};
+    }
+    flock(fd, LOCK_EX);
+
+    auto* file = fdopen(fd, "r+");
+    if (file == nullptr) {
+        close(fd);
+        return std::unexpected(Error(path));
+    }
+
+    std::string kept;
+    for (const auto& entry : ReadEntries(file)) {
+        const auto perm = Lookup(entry);
+        // an object someone else created under the key is not ours to
+        // remove, whatever the record says
+        if (!perm || perm->cuid != getuid()) {
+            continue;
+        }
+        if (CreatorAlive(entry.creator)) {
+            kept += std::format("{} {} {} {}\n", entry.type, entry.key,
+                                entry.ipc_id, entry.creator);
+            continue;
+        }
+        if (RemoveObject(entry)) {
+            ++removed;
+        }
+    }
+
+    std::expected<void, std::system_error> rewritten;
+    if (kept.empty()) {
+        unlink(path.c_str());
+    } else if (ftruncate(fd, 0) == -1 ||
+               pwrite(fd, kept.data(), kept.size(), 0) !=
+                   static_cast<ssize_t>(kept.size())) {
+        // the records of live creators may be lost, better to say so
+        rewritten = std::unexpected(Error(path));
+    }
+    std::fclose(file);  // also drops the lock
+
+    return rewritten;
+}
+}  // namespace
+
+void IpcRegistry::Record(IpcType type, key_t key, int ipc_id) {
+    const auto dir = RegistryDir(true);
+    if (!dir) {
+        return;
+    }
+
+    const auto path = std::format("{}/run-{}", *dir, IpcRun::Id());
+    const auto line = std::format("{} {} {} {}\n", static_cast<int>(type),
+                                  key, ipc_id, getpid());
+    while (true) {
+        const int fd =
+            open(path.c_str(),
+                 O_WRONLY | O_APPEND | O_CREAT | O_NOFOLLOW | O_CLOEXEC, 0600);
+        if (fd == -1) {
+            return;
+        }
+        flock(fd, LOCK_EX);
+
+        // a reclaim pass may have unlinked the file while we waited
+        struct stat file_stat{};
+        if (fstat(fd, &file_stat) == 0 && file_stat.st_nlink == 0) {
+            close(fd);
+            continue;
+        }
+
+        auto written = write(fd, line.data(), line.size());
+        (void)written;
+        close(fd);
+        return;
+    }
+}
+
+auto IpcRegistry::ReclaimStale() -> std::expected<size_t, std::system_error> {
+    const auto dir_path = RegistryDir(false);
+    if (!dir_path) {
+        // nothing was ever recorded
+        if (dir_path.error().code() == std::errc::no_such_file_or_directory) {
+            return 0;
+        }
+        return std::unexpected(dir_path.error());
+    }
+    DIR* dir = opendir(dir_path->c_str());
+    if (dir == nullptr) {
+        return std::unexpected(Error(*dir_path));
+    }
+
+    std::vector<std::string> paths;
+    while (const auto* dirent = readdir(dir)) {
+        if (std::string_view(dirent->d_name).starts_with("run-")) {
+            paths.push_back(std::format("{}/{}", *dir_path, dirent->d_name));
+        }
+    }
+    closedir(dir);
+
+    size_t removed = 0;
+    for (const auto& path : paths) {
+        if (auto reclaimed = ReclaimFile(path, removed); !reclaimed) {
+            return std::unexpected(reclaimed.error());
+        }
+    }
+    return removed;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <cstddef>
+#include <expected>
+#include <system_error>
+
+#include "ipc/ipc.h"
+
+// Remembers which process created which System V object, so objects left
+// behind by a crashed run can be removed on the next start instead of
+// making Create fail on IPC_EXCL.
+//
+// Queues and semaphore sets have no room for extra data, so the records
+// live in one file per run in a private directory of the user,
+// $XDG_RUNTIME_DIR/drone-swarm-ipc or /tmp/drone-swarm-ipc-<uid>. Each line
+// holds the object type, key, id and creator pid. Appends and the reclaim
+// pass take an flock on the file. Only objects the user created are ever
+// removed.
+class IpcRegistry {
+  public:
+    // Notes an object this process just created. Best effort: without the
+    // record the object only can't be reclaimed automatically.
+    static void Record(IpcType type, key_t key, int ipc_id);
+
+    // Removes the objects of every run whose creator is no longer alive and
+    // still exists with the recorded key, drops records of objects that are
+    // gone. Returns how many objects were removed.
+    [[nodiscard]] static auto ReclaimStale()
+        -> std::expected<size_t, std::system_error>;
+};
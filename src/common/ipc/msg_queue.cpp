@@ -6,6 +6,8 @@
 #include <cassert>
 #include <cstring>
 
+#include "ipc/ipc_registry.h"
+
 using std::expected, std::unexpected;
 
 IpcMessageQueue::IpcMessageQueue(int queue_id, bool owner)
@@ -43,28 +45,32 @@ auto IpcMessageQueue::Copy() const -> IpcMessageQueue {
 
 auto IpcMessageQueue::Create(MsgQueueKey queue_key, unsigned int permissions)
     -> expected<IpcMessageQueue, IpcError> {
-    auto key = static_cast<key_t>(queue_key);
+    auto key = IpcRun::Key(queue_key);
     auto queue_id = GetQueueId(queue_key, permissions | IPC_CREAT | IPC_EXCL);
     if (!queue_id) {
         return unexpected(IpcError(IpcType::MESSAGE_QUEUE, key, -1, errno));
     }
+    IpcRegistry::Record(IpcType::MESSAGE_QUEUE, key, *queue_id);
     return IpcMessageQueue(*queue_id, true);
 }
 
 auto IpcMessageQueue::GetOrCreate(MsgQueueKey queue_key,
                                   unsigned int permissions, bool owner)
     -> expected<IpcMessageQueue, IpcError> {
-    auto key = static_cast<key_t>(queue_key);
+    auto key = IpcRun::Key(queue_key);
     auto queue_id = GetQueueId(queue_key, permissions | IPC_CREAT);
     if (!queue_id) {
         return unexpected(IpcError(IpcType::MESSAGE_QUEUE, key, -1, errno));
     }
+    if (owner) {
+        IpcRegistry::Record(IpcType::MESSAGE_QUEUE, key, *queue_id);
+    }
     return IpcMessageQueue(*queue_id, owner);
 }
 
 auto IpcMessageQueue::Get(MsgQueueKey queue_key)
     -> expected<IpcMessageQueue, IpcError> {
-    auto key = static_cast<key_t>(queue_key);
+    auto key = IpcRun::Key(queue_key);
     auto queue_id = GetQueueId(queue_key, 0);
     if (!queue_id) {
         return unexpected(IpcError(IpcType::MESSAGE_QUEUE, key, -1, errno));
@@ -74,7 +80,7 @@ auto IpcMessageQueue::Get(MsgQueueKey queue_key)
 
 auto IpcMessageQueue::GetQueueId(MsgQueueKey queue_key, unsigned int flags)
     -> expected<int, IpcError> {
-    auto key = static_cast<key_t>(queue_key);
+    auto key = IpcRun::Key(queue_key);
     auto queue_id = msgget(key, static_cast<int>(flags));
     if (queue_id < 0) {
         return unexpected(IpcError(IpcType::MESSAGE_QUEUE, key, -1, errno));
@@ -82,6 +88,47 @@ auto IpcMessageQueue::GetQueueId(MsgQueueKey queue_key, unsigned int flags)
     return queue_id;
 }
 
+auto IpcMessageQueue::SendRaw(const void* msg, size_t size, bool wait) const
+    -> expected<void, IpcError> {
+    const auto flags = static_cast<int>(wait ? 0U : IPC_NOWAIT);
+
+    int result = 0;
+    while (true) {
+        result = msgsnd(id_, msg, size, flags);
+        const auto interrupted = result == -1 && errno == EINTR;
+        if (!interrupted || CurrentProcess::TerminateReceived()) {
+            break;
+        }
+    }
+
+    if (result == -1) {
+        return unexpected(IpcError(IpcType::MESSAGE_QUEUE, -1, id_, errno));
+    }
+
+    return {};
+}
+
+auto IpcMessageQueue::ReceiveRaw(void* msg, size_t max_size,
+                                 MessageTypeId type, bool wait) const
+    -> expected<size_t, IpcError> {
+    const auto flags = static_cast<int>(wait ? 0U : IPC_NOWAIT);
+
+    ssize_t result = 0;
+    while (true) {
+        result = msgrcv(id_, msg, max_size, static_cast<long>(type), flags);
+        const auto interrupted = result == -1 && errno == EINTR;
+        if (!interrupted || CurrentProcess::TerminateReceived()) {
+            break;
+        }
+    }
+
+    if (result == -1) {
+        return unexpected(IpcError(IpcType::MESSAGE_QUEUE, -1, id_, errno));
+    }
+
+    return static_cast<size_t>(result);
+}
+
 auto IpcMessageQueue::Remove() -> expected<void, IpcError> {
     if (owner_) {
         auto success = msgctl(id_, IPC_RMID, nullptr);
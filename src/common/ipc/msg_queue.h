@@ -2,12 +2,64 @@
 
 #include <sys/msg.h>
 
+#include <array>
+#include <cstddef>
 #include <cstring>
 #include <expected>
+#include <span>
 
 #include "ipc/ipc.h"
 #include "process.h"
 
+// Variable-length message: only the bytes appended so far travel through
+// the kernel, so small records don't pay for a worst-case struct. Capacity
+// is capped by msgmax (8192 bytes by default).
+template <size_t Capacity>
+    requires(Capacity > 0)
+class MessageBuffer {
+  public:
+    [[nodiscard]] auto Append(std::span<const std::byte> bytes) -> bool {
+        if (bytes.size() > Remaining()) {
+            return false;
+        }
+        std::memcpy(msg_.data.data() + size_, bytes.data(), bytes.size());
+        size_ += bytes.size();
+        return true;
+    }
+
+    [[nodiscard]] auto Bytes() const -> std::span<const std::byte> {
+        return {msg_.data.data(), size_};
+    }
+
+    void Clear() {
+        size_ = 0;
+    }
+
+    [[nodiscard]] auto Size() const -> size_t {
+        return size_;
+    }
+    [[nodiscard]] auto Empty() const -> bool {
+        return size_ == 0;
+    }
+    [[nodiscard]] auto Remaining() const -> size_t {
+        return Capacity - size_;
+    }
+    [[nodiscard]] static constexpr auto MaxSize() -> size_t {
+        return Capacity;
+    }
+
+  private:
+    struct Message {
+        long type = 0;  // must be > 0
+        std::array<std::byte, Capacity> data;
+    };
+
+    Message msg_{};
+    size_t size_ = 0;
+
+    friend class IpcMessageQueue;
+};
+
 class IpcMessageQueue {
   public:
     IpcMessageQueue(IpcMessageQueue&&) noexcept;
@@ -45,23 +97,28 @@ class IpcMessageQueue {
         const Message<PayloadType> msg{.type = static_cast<long>(type),
                                        .payload = payload};
 
-        const auto flags = static_cast<int>(wait ? 0U : IPC_NOWAIT);
+        return SendRaw(&msg, sizeof(PayloadType), wait);
+    }
 
-        int result = 0;
-        while (true) {
-            result = msgsnd(id_, &msg, sizeof(PayloadType), flags);
-            const auto interrupted = result == -1 && errno == EINTR;
-            if (!interrupted || CurrentProcess::TerminateReceived()) {
-                break;
-            }
+    // Sends only the used part of the buffer, an empty buffer is a no-op.
+    template <size_t Capacity>
+    [[nodiscard]]
+    auto SendBuffer(MessageBuffer<Capacity>& buffer, MessageTypeId type,
+                    bool wait = true) const -> std::expected<void, IpcError> {
+        if (buffer.Empty()) {
+            return {};
         }
+        buffer.msg_.type = static_cast<long>(type);
 
-        if (result == -1) {
-            return std::unexpected(
-                IpcError(IpcType::MESSAGE_QUEUE, -1, id_, errno));
-        }
+        return SendRaw(&buffer.msg_, buffer.size_, wait);
+    }
 
-        return {};
+    // Queues a message without payload, it only ends a receiver's wait.
+    [[nodiscard]]
+    auto SendEmpty(MessageTypeId type, bool wait = true) const
+        -> std::expected<void, IpcError> {
+        const auto msg = static_cast<long>(type);
+        return SendRaw(&msg, 0, wait);
     }
 
     template <typename PayloadType>
@@ -73,25 +130,30 @@ class IpcMessageQueue {
 
         Message<PayloadType> msg;
 
-        const auto flags = (wait ? 0U : IPC_NOWAIT);
+        auto received = ReceiveRaw(&msg, sizeof(PayloadType), type, wait);
+        if (!received) {
+            return std::unexpected(received.error());
+        }
 
-        int result = 0;
+        return msg.payload;
+    }
 
-        while (true) {
-            result = msgrcv(id_, &msg, sizeof(PayloadType),
-                            static_cast<long>(type), static_cast<int>(flags));
-            const auto interrupted = result == -1 && errno == EINTR;
-            if (!interrupted || CurrentProcess::TerminateReceived()) {
-                break;
-            }
-        }
+    // Receives one message of any length up to Capacity into `buffer`,
+    // replacing its contents.
+    template <size_t Capacity>
+    [[nodiscard]]
+    auto ReceiveBuffer(MessageBuffer<Capacity>& buffer, MessageTypeId type,
+                       bool wait = true) const
+        -> std::expected<void, IpcError> {
+        buffer.Clear();
 
-        if (result == -1) {
-            return std::unexpected(
-                IpcError(IpcType::MESSAGE_QUEUE, -1, id_, errno));
+        auto received = ReceiveRaw(&buffer.msg_, Capacity, type, wait);
+        if (!received) {
+            return std::unexpected(received.error());
         }
 
-        return msg.payload;
+        buffer.size_ = *received;
+        return {};
     }
 
   private:
@@ -107,6 +169,15 @@ class IpcMessageQueue {
     static auto GetQueueId(MsgQueueKey queue_key, unsigned int flags = 0)
         -> std::expected<int, IpcError>;
 
+    // msgsnd/msgrcv retried on EINTR until termination is requested. `msg`
+    // points at a long type followed by `size` bytes of payload.
+    [[nodiscard]]
+    auto SendRaw(const void* msg, size_t size, bool wait) const
+        -> std::expected<void, IpcError>;
+    [[nodiscard]]
+    auto ReceiveRaw(void* msg, size_t max_size, MessageTypeId type,
+                    bool wait) const -> std::expected<size_t, IpcError>;
+
     int id_;
     bool owner_;
 };
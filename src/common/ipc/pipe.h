@@ -20,6 +20,11 @@ class PipeReader {
             return std::unexpected(
                 std::system_error(errno, std::generic_category()));
         }
+        if (success != sizeof(data)) {
+            // the writer closed its end
+            return std::unexpected(std::system_error(
+                std::make_error_code(std::errc::broken_pipe)));
+        }
         return data;
     }
 
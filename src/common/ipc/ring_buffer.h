@@ -0,0 +1,193 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <optional>
+#include <system_error>
+#include <type_traits>
+
+#include "ipc/futex.h"
+#include "process.h"
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "ring buffer counters must be usable across processes");
+
+// Bounded lock-free queue meant to be placed in a SharedMemory segment.
+//
+// Every slot carries a sequence number (Vyukov's bounded queue), so
+// producers only race on head_ with a CAS and never take a lock. Pops are
+// CAS-based as well, which keeps the ring correct when a producer steals an
+// old element, but the intended use is many producers and one consumer.
+//
+// The consumer parks on a futex when the ring is empty and producers only
+// pay for a FUTEX_WAKE when it actually sleeps. Producers that find the
+// ring full (and want to wait) park on a second futex that the consumer
+// bumps after making room.
+//
+// A producer killed between claiming a slot and publishing it stalls the
+// consumer at that slot, so processes must not be SIGKILLed mid-log.
+template <typename T, size_t N>
+    requires std::is_trivially_copyable_v<T> && (N > 0) && ((N & (N - 1)) == 0)
+class RingBuffer {
+  public:
+    RingBuffer() {
+        for (size_t i = 0; i < N; ++i) {
+            slots_.at(i).seq.store(i, std::memory_order_relaxed);
+        }
+    }
+    RingBuffer(RingBuffer&&) = delete;
+    RingBuffer(const RingBuffer&) = delete;
+    auto operator=(RingBuffer&&) -> RingBuffer& = delete;
+    auto operator=(const RingBuffer&) -> RingBuffer& = delete;
+    ~RingBuffer() = default;
+
+    [[nodiscard]]
+    auto TryPush(const T& value) -> bool {
+        auto pos = head_.load(std::memory_order_relaxed);
+        while (true) {
+            auto& slot = slots_[pos & (N - 1)];
+            const auto seq = slot.seq.load(std::memory_order_acquire);
+            const auto diff = static_cast<int64_t>(seq - pos);
+            if (diff == 0) {
+                if (head_.compare_exchange_weak(pos, pos + 1,
+                                                std::memory_order_relaxed)) {
+                    slot.value = value;
+                    slot.seq.store(pos + 1, std::memory_order_release);
+                    WakeConsumer();
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Returns false only if the ring is full and `wait` is false, or the
+    // process was asked to terminate while waiting for space.
+    [[nodiscard]]
+    auto Push(const T& value, bool wait = true)
+        -> std::expected<bool, std::system_error> {
+        while (true) {
+            if (TryPush(value)) {
+                return true;
+            }
+            if (!wait || CurrentProcess::TerminateReceived()) {
+                return false;
+            }
+
+            const auto gen = space_gen_.load(std::memory_order_acquire);
+            producers_waiting_.fetch_add(1, std::memory_order_seq_cst);
+            std::expected<void, std::system_error> waited;
+            if (Full()) {
+                waited = Futex::Wait(space_gen_, gen);
+            }
+            producers_waiting_.fetch_sub(1, std::memory_order_relaxed);
+            if (!waited && !Futex::Recheck(waited.error())) {
+                return std::unexpected(waited.error());
+            }
+        }
+    }
+
+    [[nodiscard]]
+    auto TryPop() -> std::optional<T> {
+        auto pos = tail_.load(std::memory_order_relaxed);
+        while (true) {
+            auto& slot = slots_[pos & (N - 1)];
+            const auto seq = slot.seq.load(std::memory_order_acquire);
+            const auto diff = static_cast<int64_t>(seq - (pos + 1));
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1,
+                                                std::memory_order_relaxed)) {
+                    T value = slot.value;
+                    slot.seq.store(pos + N, std::memory_order_release);
+                    WakeProducers();
+                    return value;
+                }
+            } else if (diff < 0) {
+                return std::nullopt;
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Returns nullopt only if the ring is empty and `wait` is false, or the
+    // process was asked to terminate while waiting for data.
+    [[nodiscard]]
+    auto Pop(bool wait = true)
+        -> std::expected<std::optional<T>, std::system_error> {
+        while (true) {
+            if (auto value = TryPop()) {
+                return value;
+            }
+            if (!wait || CurrentProcess::TerminateReceived()) {
+                return std::nullopt;
+            }
+
+            consumer_waiting_.store(1, std::memory_order_seq_cst);
+            std::expected<void, std::system_error> waited;
+            if (Empty() && !CurrentProcess::TerminateReceived()) {
+                waited = Futex::Wait(consumer_waiting_, 1);
+            }
+            consumer_waiting_.store(0, std::memory_order_relaxed);
+            if (!waited && !Futex::Recheck(waited.error())) {
+                return std::unexpected(waited.error());
+            }
+        }
+    }
+
+    // Wakes a consumer parked in Pop, so it notices a termination request
+    // raised after it checked.
+    void Interrupt() { WakeConsumer(); }
+
+    [[nodiscard]]
+    auto Empty() const -> bool {
+        const auto pos = tail_.load(std::memory_order_seq_cst);
+        const auto& slot = slots_[pos & (N - 1)];
+        return slot.seq.load(std::memory_order_seq_cst) != pos + 1;
+    }
+
+    [[nodiscard]]
+    auto Full() const -> bool {
+        const auto pos = head_.load(std::memory_order_seq_cst);
+        const auto& slot = slots_[pos & (N - 1)];
+        return slot.seq.load(std::memory_order_seq_cst) != pos;
+    }
+
+  private:
+    struct Slot {
+        std::atomic<uint64_t> seq;
+        T value;
+    };
+
+    void WakeConsumer() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (consumer_waiting_.load(std::memory_order_relaxed) != 0 &&
+            consumer_waiting_.exchange(0, std::memory_order_relaxed) != 0) {
+            Futex::Wake(consumer_waiting_, 1);
+        }
+    }
+
+    void WakeProducers() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (producers_waiting_.load(std::memory_order_relaxed) != 0) {
+            space_gen_.fetch_add(1, std::memory_order_release);
+            Futex::Wake(space_gen_, INT_MAX);
+        }
+    }
+
+    // Cache line padding keeps the producers' CAS traffic on head_ away from
+    // the consumer's tail_.
+    alignas(64) std::atomic<uint64_t> head_{0};
+    alignas(64) std::atomic<uint64_t> tail_{0};
+    alignas(64) std::atomic<uint32_t> consumer_waiting_{0};
+    std::atomic<uint32_t> producers_waiting_{0};
+    std::atomic<uint32_t> space_gen_{0};
+    alignas(64) std::array<Slot, N> slots_;
+};
@@ -0,0 +1,35 @@
+#include "semaphore_set.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <ctime>
+
+auto SemOps(int sem_id, std::span<sembuf> ops,
+            std::optional<MonotonicClock::time_point> deadline)
+    -> std::expected<void, IpcError> {
+    using std::chrono::nanoseconds, std::chrono::seconds;
+
+    while (true) {
+        int result = 0;
+        if (deadline) {
+            const auto left = std::max(
+                std::chrono::duration_cast<nanoseconds>(
+                    *deadline - MonotonicClock::now()),
+                nanoseconds(0));
+            const auto sec = std::chrono::duration_cast<seconds>(left);
+            const timespec timeout{.tv_sec = sec.count(),
+                                   .tv_nsec = (left - sec).count()};
+            result = semtimedop(sem_id, ops.data(), ops.size(), &timeout);
+        } else {
+            result = semop(sem_id, ops.data(), ops.size());
+        }
+        if (result == 0) {
+            return {};
+        }
+        if (errno != EINTR || CurrentProcess::TerminateReceived()) {
+            return std::unexpected(
+                IpcError(IpcType::SEMAPHORE_SET, -1, sem_id, errno));
+        }
+    }
+}
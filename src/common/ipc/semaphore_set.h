@@ -1,12 +1,17 @@
 #pragma once
 #include <sys/sem.h>
 
+#include <array>
 #include <cassert>
 #include <cstring>
 #include <expected>
+#include <initializer_list>
+#include <optional>
 #include <span>
 
+#include "clock.h"
 #include "ipc/ipc.h"
+#include "ipc/ipc_registry.h"
 #include "process.h"
 
 union semun {
@@ -16,10 +21,36 @@ union semun {
     struct seminfo* info_buf;       // Buffer for IPC_INFO (Linux-specific)
 };
 
+// semop, or semtimedop with whatever is left until `deadline`, retried on
+// EINTR until termination is requested. A passed deadline fails with
+// EAGAIN, like IPC_NOWAIT.
+[[nodiscard]]
+auto SemOps(int sem_id, std::span<sembuf> ops,
+            std::optional<MonotonicClock::time_point> deadline = std::nullopt)
+    -> std::expected<void, IpcError>;
+
 template <typename E>
     requires std::is_enum_v<E> && requires { E::COUNT; }
 class SemaphoreSet {
   public:
+    // One semaphore's part of an atomic operation: a negative delta waits
+    // until it can be taken, zero waits for the semaphore to be zero.
+    struct Op {
+        E sem;
+        short delta;
+    };
+
+    struct OpOptions {
+        // fail with EAGAIN instead of blocking
+        bool no_wait = false;
+        // reverted by the kernel when the process exits
+        bool undo = false;
+        std::optional<MonotonicClock::time_point> deadline;
+    };
+
+    // semop(2) limits a call to SEMOPM operations, 32 at the least
+    static constexpr size_t max_ops_ = 32;
+
     SemaphoreSet(SemaphoreSet&& other) noexcept
         : id_(other.id_), owner_(other.owner_) {
         other.owner_ = false;
@@ -61,7 +92,7 @@ class SemaphoreSet {
                        std::span<const unsigned short> init,
                        unsigned int permissions)
         -> std::expected<SemaphoreSet, IpcError> {
-        auto key = static_cast<key_t>(sem_key);
+        auto key = IpcRun::Key(sem_key);
 
         if (init.size() != static_cast<size_t>(E::COUNT)) {
             return std::unexpected(
@@ -73,6 +104,7 @@ class SemaphoreSet {
             return std::unexpected(
                 IpcError(IpcType::SEMAPHORE_SET, key, -1, errno));
         }
+        IpcRegistry::Record(IpcType::SEMAPHORE_SET, key, *sem_id);
 
         // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
         semun arg{.get_set_array = const_cast<unsigned short*>(init.data())};
@@ -87,7 +119,7 @@ class SemaphoreSet {
     [[nodiscard]]
     static auto Get(SemaphoreSetKey sem_key)
         -> std::expected<SemaphoreSet, IpcError> {
-        auto key = static_cast<key_t>(sem_key);
+        auto key = IpcRun::Key(sem_key);
         auto sem_id = GetSemId(sem_key, 0);
         if (!sem_id) {
             return std::unexpected(
@@ -100,6 +132,35 @@ class SemaphoreSet {
         owner_ = false;
     }
 
+    // Applies all operations in one semop call, either all of them or, on
+    // error, none.
+    [[nodiscard]]
+    auto Apply(std::span<const Op> ops, OpOptions options = {}) const
+        -> std::expected<void, IpcError> {
+        if (ops.size() > max_ops_) {
+            return std::unexpected(
+                IpcError(IpcType::SEMAPHORE_SET, -1, id_, E2BIG));
+        }
+
+        const auto flags = static_cast<short>(
+            (options.no_wait ? IPC_NOWAIT : 0) | (options.undo ? SEM_UNDO : 0));
+        std::array<sembuf, max_ops_> sops{};
+        for (size_t i = 0; i < ops.size(); ++i) {
+            sops.at(i) = {.sem_num = static_cast<unsigned short>(ops[i].sem),
+                          .sem_op = ops[i].delta,
+                          .sem_flg = flags};
+        }
+
+        return SemOps(id_, std::span(sops).first(ops.size()),
+                      options.deadline);
+    }
+
+    [[nodiscard]]
+    auto Apply(std::initializer_list<Op> ops, OpOptions options = {}) const
+        -> std::expected<void, IpcError> {
+        return Apply(std::span(ops.begin(), ops.end()), options);
+    }
+
     [[nodiscard]] auto Copy() const -> SemaphoreSet {
         return SemaphoreSet(id_, false);
     }
@@ -125,7 +186,7 @@ class SemaphoreSet {
     [[nodiscard]]
     static auto GetSemId(SemaphoreSetKey sem_key, unsigned int flags = 0)
         -> std::expected<int, IpcError> {
-        auto key = static_cast<key_t>(sem_key);
+        auto key = IpcRun::Key(sem_key);
         auto sem_id =
             semget(key, static_cast<int>(E::COUNT), static_cast<int>(flags));
         if (sem_id < 0) {
@@ -188,17 +249,7 @@ class Semaphore {
 
     [[nodiscard]]
     auto SemOp(sembuf sop) const -> std::expected<void, IpcError> {
-        while (true) {
-            auto error = semop(semset_id_, &sop, 1);
-            if (error == 0) {
-                return {};
-            }
-            if (error != EINTR || CurrentProcess::TerminateReceived()) {
-                return std::unexpected(
-                    IpcError(IpcType::SEMAPHORE_SET, -1, semset_id_, errno));
-            }
-        }
-        return {};
+        return SemOps(semset_id_, std::span(&sop, 1));
     }
 
     int semset_id_;
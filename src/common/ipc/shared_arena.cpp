@@ -0,0 +1,125 @@
+#include "shared_arena.h"
+
+#include <sys/shm.h>
+
+#include <cerrno>
+
+#include "ipc/ipc_registry.h"
+
+using std::expected, std::unexpected;
+
+namespace {
+constexpr uint64_t g_arena_magic = 0x414e455241575344;  // "DSWARENA"
+}  // namespace
+
+SharedArena::SharedArena(int mem_id, bool owner)
+    : id_(mem_id), owner_(owner) {}
+
+SharedArena::SharedArena(SharedArena&& other) noexcept
+    : id_(other.id_), base_(other.base_), owner_(other.owner_) {
+    other.owner_ = false;
+    other.base_ = nullptr;
+}
+
+SharedArena::~SharedArena() {
+    if (base_ != nullptr) {
+        shmdt(base_);
+    }
+    if (owner_) {
+        auto removed = Remove();
+    }
+}
+
+auto SharedArena::Create(SharedMemoryKey key, size_t size,
+                         unsigned int permissions)
+    -> expected<SharedArena, IpcError> {
+    const auto raw_key = IpcRun::Key(key);
+    const auto total = sizeof(ArenaHeader) + size;
+    auto mem_id = shmget(raw_key, total,
+                         static_cast<int>(permissions | IPC_CREAT | IPC_EXCL));
+    if (mem_id < 0) {
+        return unexpected(IpcError(IpcType::SHARED_MEMORY, raw_key, -1, errno));
+    }
+    IpcRegistry::Record(IpcType::SHARED_MEMORY, raw_key, mem_id);
+    auto ret = SharedArena(mem_id, true);
+
+    auto attached = ret.Attach();
+    if (!attached) {
+        return unexpected(attached.error());
+    }
+
+    new (ret.base_) ArenaHeader{.magic = g_arena_magic,
+                                .size = total,
+                                .used = sizeof(ArenaHeader),
+                                .root = 0};
+
+    return ret;
+}
+
+auto SharedArena::Get(SharedMemoryKey key) -> expected<SharedArena, IpcError> {
+    const auto raw_key = IpcRun::Key(key);
+    auto mem_id = shmget(raw_key, 0, 0);
+    if (mem_id < 0) {
+        return unexpected(IpcError(IpcType::SHARED_MEMORY, raw_key, -1, errno));
+    }
+    auto ret = SharedArena(mem_id);
+
+    auto attached = ret.Attach();
+    if (!attached) {
+        return unexpected(attached.error());
+    }
+    if (ret.Header().magic != g_arena_magic) {
+        return unexpected(
+            IpcError(IpcType::SHARED_MEMORY, raw_key, mem_id, EINVAL));
+    }
+
+    return ret;
+}
+
+auto SharedArena::Copy() const -> expected<SharedArena, IpcError> {
+    auto ret = SharedArena(id_, false);
+
+    auto attached = ret.Attach();
+    if (!attached) {
+        return unexpected(attached.error());
+    }
+
+    return ret;
+}
+
+auto SharedArena::Remove() -> expected<void, IpcError> {
+    if (owner_) {
+        if (shmctl(id_, IPC_RMID, nullptr) == -1) {
+            return unexpected(IpcError(IpcType::SHARED_MEMORY, -1, id_, errno));
+        }
+    }
+    owner_ = false;
+
+    return {};
+}
+
+auto SharedArena::Allocate(size_t size, size_t alignment)
+    -> expected<void*, IpcError> {
+    auto& header = Header();
+    auto used = header.used.load(std::memory_order_relaxed);
+    while (true) {
+        // segments are page aligned, so aligning the offset is enough
+        const auto start = (used + alignment - 1) & ~(alignment - 1);
+        if (start > header.size || size > header.size - start) {
+            return unexpected(IpcError(IpcType::SHARED_MEMORY, -1, id_, ENOMEM));
+        }
+        if (header.used.compare_exchange_weak(used, start + size,
+                                              std::memory_order_relaxed)) {
+            return base_ + start;
+        }
+    }
+}
+
+auto SharedArena::Attach() -> expected<void, IpcError> {
+    auto* mem = shmat(id_, nullptr, 0);
+    if (reinterpret_cast<std::intptr_t>(mem) == -1) {
+        return unexpected(IpcError(IpcType::SHARED_MEMORY, -1, id_, errno));
+    }
+    base_ = static_cast<std::byte*>(mem);
+    return {};
+}
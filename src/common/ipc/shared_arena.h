@@ -0,0 +1,364 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <new>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+#include "ipc/futex_sync.h"
+#include "ipc/ipc.h"
+
+// Pointer that stays valid wherever the segment holding it is mapped: it
+// stores the distance from itself to the target, so both have to live in
+// the same segment. Null is a zero distance, an OffsetPtr can't point at
+// itself.
+template <typename T>
+class OffsetPtr {
+  public:
+    OffsetPtr() = default;
+    // NOLINTNEXTLINE(google-explicit-constructor)
+    OffsetPtr(T* ptr) {
+        Set(ptr);
+    }
+    OffsetPtr(const OffsetPtr& other) {
+        Set(other.Get());
+    }
+    auto operator=(const OffsetPtr& other) -> OffsetPtr& {
+        Set(other.Get());
+        return *this;
+    }
+    auto operator=(T* ptr) -> OffsetPtr& {
+        Set(ptr);
+        return *this;
+    }
+    OffsetPtr(OffsetPtr&&) = delete;
+    auto operator=(OffsetPtr&&) -> OffsetPtr& = delete;
+    ~OffsetPtr() = default;
+
+    [[nodiscard]] auto Get() const -> T* {
+        if (offset_ == 0) {
+            return nullptr;
+        }
+        return reinterpret_cast<T*>(reinterpret_cast<std::intptr_t>(this) +
+                                    offset_);
+    }
+
+    auto operator->() const -> T* {
+        return Get();
+    }
+    auto operator*() const -> T& {
+        return *Get();
+    }
+    explicit operator bool() const {
+        return offset_ != 0;
+    }
+
+  private:
+    void Set(T* ptr) {
+        offset_ = ptr == nullptr ? 0
+                                 : reinterpret_cast<std::intptr_t>(ptr) -
+                                       reinterpret_cast<std::intptr_t>(this);
+    }
+
+    std::intptr_t offset_ = 0;
+};
+
+// Shared memory segment of a size chosen at runtime, handed out by a bump
+// allocator. Nothing is ever freed back to the arena, containers that need
+// to reuse space (SharedSlotMap) pool it themselves.
+//
+// The creator sets a root object, processes that Get the arena find
+// everything else through it. Objects are placed with New and must only
+// refer to each other through OffsetPtr, each process maps the segment at
+// its own address.
+class SharedArena {
+  public:
+    SharedArena(SharedArena&& other) noexcept;
+    auto operator=(SharedArena&&) = delete;
+    SharedArena(const SharedArena&) = delete;
+    auto operator=(const SharedArena&) -> SharedArena& = delete;
+    ~SharedArena();
+
+    [[nodiscard]]
+    static auto Create(SharedMemoryKey key, size_t size,
+                       unsigned int permissions)
+        -> std::expected<SharedArena, IpcError>;
+
+    [[nodiscard]]
+    static auto Get(SharedMemoryKey key)
+        -> std::expected<SharedArena, IpcError>;
+
+    [[nodiscard]] auto Copy() const -> std::expected<SharedArena, IpcError>;
+
+    void Disown() {
+        owner_ = false;
+    }
+
+    [[nodiscard]]
+    auto Remove() -> std::expected<void, IpcError>;
+
+    // Fails with ENOMEM once the arena is used up. Safe to call from
+    // several processes at once.
+    [[nodiscard]]
+    auto Allocate(size_t size, size_t alignment)
+        -> std::expected<void*, IpcError>;
+
+    template <typename T, typename... Args>
+    [[nodiscard]] auto New(Args&&... args) -> std::expected<T*, IpcError> {
+        auto mem = Allocate(sizeof(T), alignof(T));
+        if (!mem) {
+            return std::unexpected(mem.error());
+        }
+        return new (*mem) T(std::forward<Args>(args)...);
+    }
+
+    // Value-initialized array of `count` elements.
+    template <typename T>
+    [[nodiscard]] auto NewArray(size_t count)
+        -> std::expected<std::span<T>, IpcError> {
+        if (count > (Size() / sizeof(T))) {
+            return std::unexpected(
+                IpcError(IpcType::SHARED_MEMORY, -1, id_, ENOMEM));
+        }
+        auto mem = Allocate(sizeof(T) * count, alignof(T));
+        if (!mem) {
+            return std::unexpected(mem.error());
+        }
+        auto* first = static_cast<T*>(*mem);
+        for (size_t i = 0; i < count; ++i) {
+            new (first + i) T{};
+        }
+        return std::span<T>(first, count);
+    }
+
+    template <typename T>
+    void SetRoot(T* root) {
+        Header().root.store(Offset(root), std::memory_order_release);
+    }
+
+    // nullptr until the creator set the root.
+    template <typename T>
+    [[nodiscard]] auto Root() const -> T* {
+        const auto offset = Header().root.load(std::memory_order_acquire);
+        return offset == 0 ? nullptr : reinterpret_cast<T*>(base_ + offset);
+    }
+
+    [[nodiscard]] auto Size() const -> size_t {
+        return Header().size;
+    }
+    [[nodiscard]] auto Used() const -> size_t {
+        return Header().used.load(std::memory_order_relaxed);
+    }
+
+  private:
+    struct ArenaHeader {
+        uint64_t magic;
+        uint64_t size;
+        std::atomic<uint64_t> used;
+        std::atomic<uint64_t> root;
+    };
+
+    explicit SharedArena(int mem_id, bool owner = false);
+
+    [[nodiscard]] auto Header() const -> ArenaHeader& {
+        return *reinterpret_cast<ArenaHeader*>(base_);
+    }
+    [[nodiscard]] auto Offset(const void* ptr) const -> uint64_t {
+        return static_cast<uint64_t>(static_cast<const std::byte*>(ptr) -
+                                     base_);
+    }
+
+    [[nodiscard]]
+    auto Attach() -> std::expected<void, IpcError>;
+
+    int id_;
+    std::byte* base_{};
+    bool owner_;
+};
+
+// Vector with its capacity fixed at creation, elements live in the arena.
+// Not synchronized, guard it with a FutexMutex if several processes
+// change it.
+template <typename T>
+    requires std::is_trivially_copyable_v<T>
+class SharedVector {
+  public:
+    [[nodiscard]]
+    static auto Create(SharedArena& arena, size_t capacity)
+        -> std::expected<SharedVector*, IpcError> {
+        auto data = arena.NewArray<T>(capacity);
+        if (!data) {
+            return std::unexpected(data.error());
+        }
+        return arena.New<SharedVector>(data->data(), capacity);
+    }
+
+    SharedVector(T* data, size_t capacity)
+        : data_(data), capacity_(capacity) {}
+
+    [[nodiscard]] auto PushBack(const T& value) -> bool {
+        if (size_ == capacity_) {
+            return false;
+        }
+        data_.Get()[size_++] = value;
+        return true;
+    }
+
+    // Grows with value-initialized elements or shrinks, in place.
+    [[nodiscard]] auto Resize(size_t size) -> bool {
+        if (size > capacity_) {
+            return false;
+        }
+        for (auto i = size_; i < size; ++i) {
+            data_.Get()[i] = T{};
+        }
+        size_ = size;
+        return true;
+    }
+
+    void Clear() {
+        size_ = 0;
+    }
+
+    auto operator[](size_t index) -> T& {
+        return data_.Get()[index];
+    }
+    auto operator[](size_t index) const -> const T& {
+        return data_.Get()[index];
+    }
+
+    [[nodiscard]] auto Size() const -> size_t {
+        return size_;
+    }
+    [[nodiscard]] auto Capacity() const -> size_t {
+        return capacity_;
+    }
+
+    [[nodiscard]] auto Span() -> std::span<T> {
+        return {data_.Get(), size_};
+    }
+    [[nodiscard]] auto Span() const -> std::span<const T> {
+        return {data_.Get(), size_};
+    }
+
+    [[nodiscard]] auto begin() {  // NOLINT(readability-identifier-naming)
+        return Span().begin();
+    }
+    [[nodiscard]] auto end() {  // NOLINT(readability-identifier-naming)
+        return Span().end();
+    }
+
+  private:
+    OffsetPtr<T> data_;
+    size_t capacity_;
+    size_t size_ = 0;
+};
+
+// Fixed pool of slots addressed by handles that go stale once their slot
+// is erased, so a reused slot is never mistaken for the old element.
+// Insert and Erase take the map's FutexMutex, any process may call them.
+template <typename T>
+    requires std::is_trivially_copyable_v<T>
+class SharedSlotMap {
+    struct Slot;
+
+  public:
+    struct Handle {
+        uint32_t index;
+        uint32_t generation;
+    };
+
+    [[nodiscard]]
+    static auto Create(SharedArena& arena, size_t capacity)
+        -> std::expected<SharedSlotMap*, IpcError> {
+        auto slots = arena.NewArray<Slot>(capacity);
+        if (!slots) {
+            return std::unexpected(slots.error());
+        }
+        return arena.New<SharedSlotMap>(*slots);
+    }
+
+    explicit SharedSlotMap(std::span<Slot> slots)
+        : slots_(slots.data()), capacity_(static_cast<uint32_t>(slots.size())) {
+        // every slot starts on the free list, in index order
+        for (size_t i = 0; i < capacity_; ++i) {
+            slots[i].next_free = static_cast<uint32_t>(i + 1);
+        }
+    }
+
+    // nullopt when all slots are taken.
+    [[nodiscard]] auto Insert(const T& value) -> std::optional<Handle> {
+        mutex_.Lock();
+        if (free_ == capacity_) {
+            mutex_.Unlock();
+            return std::nullopt;
+        }
+        const auto index = free_;
+        auto& slot = slots_.Get()[index];
+        free_ = slot.next_free;
+        slot.value = value;
+        slot.used = true;
+        const Handle handle{.index = index, .generation = slot.generation};
+        ++size_;
+        mutex_.Unlock();
+        return handle;
+    }
+
+    auto Erase(Handle handle) -> bool {
+        mutex_.Lock();
+        auto* slot = Find(handle);
+        if (slot != nullptr) {
+            slot->used = false;
+            ++slot->generation;
+            slot->next_free = free_;
+            free_ = handle.index;
+            --size_;
+        }
+        mutex_.Unlock();
+        return slot != nullptr;
+    }
+
+    // nullptr for stale handles. The element may be erased concurrently,
+    // callers coordinate that themselves.
+    [[nodiscard]] auto Get(Handle handle) -> T* {
+        auto* slot = Find(handle);
+        return slot == nullptr ? nullptr : &slot->value;
+    }
+
+    [[nodiscard]] auto Size() const -> size_t {
+        return size_;
+    }
+    [[nodiscard]] auto Capacity() const -> size_t {
+        return capacity_;
+    }
+
+  private:
+    struct Slot {
+        T value;
+        uint32_t generation;
+        uint32_t next_free;
+        bool used;
+    };
+
+    [[nodiscard]] auto Find(Handle handle) -> Slot* {
+        if (handle.index >= capacity_) {
+            return nullptr;
+        }
+        auto& slot = slots_.Get()[handle.index];
+        if (!slot.used || slot.generation != handle.generation) {
+            return nullptr;
+        }
+        return &slot;
+    }
+
+    FutexMutex mutex_;
+    OffsetPtr<Slot> slots_;
+    uint32_t capacity_;
+    uint32_t free_ = 0;
+    uint32_t size_ = 0;
+};
@@ -3,8 +3,10 @@
 
 #include <cstring>
 #include <expected>
+#include <new>
 
 #include "ipc/ipc.h"
+#include "ipc/ipc_registry.h"
 
 template <typename T>
 class SharedMemory {
@@ -44,12 +46,13 @@ class SharedMemory {
     [[nodiscard]]
     static auto Create(SharedMemoryKey queue_key, unsigned int permissions)
         -> std::expected<SharedMemory, IpcError> {
-        auto key = static_cast<key_t>(queue_key);
+        auto key = IpcRun::Key(queue_key);
         auto mem_id = GetMemId(queue_key, permissions | IPC_CREAT | IPC_EXCL);
         if (!mem_id) {
             return std::unexpected(
                 IpcError(IpcType::SHARED_MEMORY, key, -1, errno));
         }
+        IpcRegistry::Record(IpcType::SHARED_MEMORY, key, *mem_id);
         auto ret = SharedMemory(*mem_id, true);
 
         auto atached = ret.Attach();
@@ -57,30 +60,45 @@ class SharedMemory {
             return std::unexpected(atached.error());
         }
 
-        T init{};
-        memcpy(ret.ptr_, &init, sizeof(T));
+        // constructed in place, T may hold atomics or be too big for the stack
+        new (ret.ptr_) T{};
 
-        return std::move(ret);
+        return ret;
     }
 
     [[nodiscard]]
     static auto Get(SharedMemoryKey queue_key)
         -> std::expected<SharedMemory, IpcError> {
-        auto key = static_cast<key_t>(queue_key);
+        auto key = IpcRun::Key(queue_key);
         auto mem_id = GetMemId(queue_key, 0);
         if (!mem_id) {
             return std::unexpected(
                 IpcError(IpcType::SHARED_MEMORY, key, -1, errno));
         }
-        return SharedMemory(*mem_id);
+        auto ret = SharedMemory(*mem_id);
+
+        auto atached = ret.Attach();
+        if (!atached) {
+            return std::unexpected(atached.error());
+        }
+
+        return ret;
     }
 
     void Disown() {
         owner_ = false;
     }
 
-    [[nodiscard]] auto Copy() const -> SharedMemory {
-        return SharedMemory(id_, false, ptr_);
+    // Attaches the segment again, so the copy can be detached on its own.
+    [[nodiscard]] auto Copy() const -> std::expected<SharedMemory, IpcError> {
+        auto ret = SharedMemory(id_, false);
+
+        auto atached = ret.Attach();
+        if (!atached) {
+            return std::unexpected(atached.error());
+        }
+
+        return ret;
     }
 
     [[nodiscard]]
@@ -112,7 +130,7 @@ class SharedMemory {
     [[nodiscard]]
     static auto GetMemId(SharedMemoryKey queue_key, unsigned int flags = 0)
         -> std::expected<int, IpcError> {
-        auto key = static_cast<key_t>(queue_key);
+        auto key = IpcRun::Key(queue_key);
         auto mem_id = shmget(key, sizeof(T), static_cast<int>(flags));
         if (mem_id < 0) {
             return std::unexpected(
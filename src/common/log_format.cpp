@@ -0,0 +1,85 @@
+#include "log_format.h"
+
+#include <array>
+#include <format>
+#include <iterator>
+
+namespace {
+// An argument slot of a record, missing ones render as '?' so a truncated
+// record can't pass for real zeros.
+struct LogArg {
+    int64_t value = 0;
+    bool present = false;
+};
+}  // namespace
+
+template <>
+struct std::formatter<LogArg> : std::formatter<int64_t> {
+    auto format(const LogArg& arg, std::format_context& ctx) const {
+        if (!arg.present) {
+            return std::format_to(ctx.out(), "?");
+        }
+        return std::formatter<int64_t>::format(arg.value, ctx);
+    }
+};
+
+namespace {
+constexpr std::array<std::string_view, static_cast<size_t>(LogFormatId::COUNT)>
+    g_log_formats = {
+        "",
+        "Bat: {:>3}%",
+        "Suppressed {} lines of log format {}",
+        "Log overflow: dropped {} records, spilled {} records",
+        "Suicide mission order {} accepted",
+        "Suicide mission order {} ignored",
+        "Drone {} exited with status {}",
+        "Drone {} killed by signal {}",
+        "Swarm at {}s: {} flying, {} docked, {} gone",
+        "Swarm of {} simulated for {}s in {}ms, {} decommissioned",
+        "Suicide mission ordered to {} drones",
+        "Drone {} accepted order {}",
+        "Drone {} refused order {}",
+};
+}  // namespace
+
+auto LogFormatString(LogFormatId format) -> std::string_view {
+    const auto index = static_cast<size_t>(format);
+    if (index >= g_log_formats.size()) {
+        return {};
+    }
+    return g_log_formats.at(index);
+}
+
+auto RenderLogFormat(LogFormatId format, std::span<const int64_t> args)
+    -> std::string {
+    std::string rendered;
+    RenderLogFormat(format, args, rendered);
+    return rendered;
+}
+
+void RenderLogFormat(LogFormatId format, std::span<const int64_t> args,
+                     std::string& out) {
+    const auto fmt = LogFormatString(format);
+    if (fmt.empty() || args.size() > g_log_format_max_args) {
+        std::format_to(std::back_inserter(out), "<unknown log format {}>",
+                       static_cast<int>(format));
+        return;
+    }
+
+    std::array<LogArg, g_log_format_max_args> padded{};
+    for (size_t i = 0; i < args.size(); ++i) {
+        padded.at(i) = {.value = args[i], .present = true};
+    }
+    auto& [a0, a1, a2, a3] = padded;
+
+    const auto size = out.size();
+    try {
+        std::vformat_to(std::back_inserter(out), fmt,
+                        std::make_format_args(a0, a1, a2, a3));
+    } catch (const std::format_error&) {
+        out.resize(size);
+        std::format_to(std::back_inserter(out),
+                       "<bad arguments for log format {}>",
+                       static_cast<int>(format));
+    }
+}
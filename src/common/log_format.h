@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+
+// Format strings for deferred formatting. Producers only send the id and raw
+// integer arguments, the text is rendered by the logger process or, for
+// binary logs, by logdecode. Ids end up in report files, so only append.
+// NOLINTNEXTLINE(performance-enum-size)
+enum class LogFormatId : uint8_t {
+    TEXT,  // not a format, the record carries its message as text
+    BATTERY_LEVEL,
+    SUPPRESSED_LINES,
+    LOG_OVERFLOWS,
+    SUICIDE_ORDER_ACCEPTED,
+    SUICIDE_ORDER_IGNORED,
+    DRONE_EXITED,
+    DRONE_KILLED,
+    SWARM_SUMMARY,
+    SWARM_DONE,
+    SUICIDE_ORDERS_SENT,
+    ORDER_ACCEPTED_BY,
+    ORDER_REFUSED_BY,
+    COUNT
+};
+
+constexpr size_t g_log_format_max_args = 4;
+
+[[nodiscard]] auto LogFormatString(LogFormatId format) -> std::string_view;
+
+// Unknown ids and missing arguments are rendered as a placeholder instead of
+// failing, binary logs may come from a newer build.
+[[nodiscard]] auto RenderLogFormat(LogFormatId format,
+                                   std::span<const int64_t> args)
+    -> std::string;
+// Same, appended to `out` so a buffer can be reused across lines.
+void RenderLogFormat(LogFormatId format, std::span<const int64_t> args,
+                     std::string& out);
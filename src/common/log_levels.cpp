@@ -0,0 +1,128 @@
+#include "log_levels.h"
+
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+auto LogLevels::SenderHash(std::string_view sender) -> uint64_t {
+    // FNV-1a, 0 is reserved for free slots
+    uint64_t hash = 14695981039346656037ULL;
+    for (const char chr : sender) {
+        hash ^= static_cast<unsigned char>(chr);
+        hash *= 1099511628211ULL;
+    }
+    return hash == 0 ? 1 : hash;
+}
+
+namespace {
+
+auto PackState(pid_t writer, uint32_t generation) -> uint64_t {
+    return (static_cast<uint64_t>(writer) << 32U) | generation;
+}
+
+auto WriterAlive(pid_t writer) -> bool {
+    return kill(writer, 0) == 0 || errno != ESRCH;
+}
+
+}  // namespace
+
+void LogLevels::Update(auto&& update) {
+    const auto self = getpid();
+    auto state = state_.load(std::memory_order_relaxed);
+    while (true) {
+        const auto generation = static_cast<uint32_t>(state);
+        auto desired = PackState(self, generation + 1);
+        if ((generation & 1U) != 0) {
+            if (WriterAlive(static_cast<pid_t>(state >> 32U))) {
+                sched_yield();
+                state = state_.load(std::memory_order_relaxed);
+                continue;
+            }
+            // the writer died mid-update, redo it under a new odd generation
+            desired = PackState(self, generation + 2);
+        }
+        if (state_.compare_exchange_weak(state, desired,
+                                         std::memory_order_acquire)) {
+            state = desired;
+            break;
+        }
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+
+    update();
+
+    state_.store(PackState(self, static_cast<uint32_t>(state) + 1),
+                 std::memory_order_release);
+}
+
+auto LogLevels::Effective(uint64_t sender_hash) const
+    -> std::pair<uint32_t, uint8_t> {
+    for (size_t attempt = 0;; ++attempt) {
+        const auto generation =
+            static_cast<uint32_t>(state_.load(std::memory_order_acquire));
+        const bool settle = attempt >= max_read_retries_;
+        if ((generation & 1U) != 0 && !settle) {
+            continue;
+        }
+
+        auto level = min_level_.load(std::memory_order_relaxed);
+        for (const auto& entry : overrides_) {
+            if (entry.sender_hash.load(std::memory_order_relaxed) ==
+                sender_hash) {
+                level = entry.level.load(std::memory_order_relaxed);
+                break;
+            }
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (settle || Generation() == generation) {
+            return {generation, level};
+        }
+    }
+}
+
+void LogLevels::SetMinLevel(uint8_t level) {
+    Update([&]() { min_level_.store(level, std::memory_order_relaxed); });
+}
+
+auto LogLevels::SetOverride(std::string_view sender, uint8_t level) -> bool {
+    const auto hash = SenderHash(sender);
+    bool stored = false;
+
+    Update([&]() {
+        Override* free_slot = nullptr;
+        for (auto& entry : overrides_) {
+            const auto entry_hash =
+                entry.sender_hash.load(std::memory_order_relaxed);
+            if (entry_hash == hash) {
+                entry.level.store(level, std::memory_order_relaxed);
+                stored = true;
+                return;
+            }
+            if (entry_hash == 0 && free_slot == nullptr) {
+                free_slot = &entry;
+            }
+        }
+        if (free_slot != nullptr) {
+            free_slot->level.store(level, std::memory_order_relaxed);
+            free_slot->sender_hash.store(hash, std::memory_order_relaxed);
+            stored = true;
+        }
+    });
+
+    return stored;
+}
+
+void LogLevels::ClearOverride(std::string_view sender) {
+    const auto hash = SenderHash(sender);
+
+    Update([&]() {
+        for (auto& entry : overrides_) {
+            if (entry.sender_hash.load(std::memory_order_relaxed) == hash) {
+                entry.sender_hash.store(0, std::memory_order_relaxed);
+            }
+        }
+    });
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+
+// Runtime log levels shared by every process through SharedMemory. Levels
+// are Logger::LogLevel values. Senders are matched by a hash of their
+// name, so the whole block is made of atomics and is safe to read while
+// another process updates it.
+//
+// Updates are published seqlock-style through the generation: readers cache
+// their effective level together with the generation it was computed for
+// and only rescan after it changed. A writer killed mid-update leaves the
+// generation odd; readers give up retrying after a bound and the next writer
+// takes the update over once the recorded writer pid is gone.
+//
+// The printer also publishes here how many message queues it reads, so
+// loggers attached to the block know which shard to send to.
+class LogLevels {
+  public:
+    static constexpr size_t max_overrides_ = 32;
+
+    [[nodiscard]] static auto SenderHash(std::string_view sender) -> uint64_t;
+
+    [[nodiscard]] auto Generation() const -> uint32_t {
+        return static_cast<uint32_t>(state_.load(std::memory_order_relaxed));
+    }
+
+    // Returns the generation it was computed for and the minimum level for
+    // `sender_hash`. While an update is stuck the generation is odd and the
+    // level an unverified read, callers rescan once the generation moves.
+    [[nodiscard]] auto Effective(uint64_t sender_hash) const
+        -> std::pair<uint32_t, uint8_t>;
+
+    void SetMinLevel(uint8_t level);
+    // False if all override slots are taken.
+    [[nodiscard]] auto SetOverride(std::string_view sender, uint8_t level)
+        -> bool;
+    void ClearOverride(std::string_view sender);
+
+    [[nodiscard]] auto QueueShards() const -> uint32_t {
+        return std::max<uint32_t>(
+            queue_shards_.load(std::memory_order_relaxed), 1);
+    }
+    void SetQueueShards(uint32_t shards) {
+        queue_shards_.store(shards, std::memory_order_relaxed);
+    }
+
+  private:
+    struct Override {
+        std::atomic<uint64_t> sender_hash;  // 0 marks a free slot
+        std::atomic<uint8_t> level;
+    };
+
+    // reader attempts before settling for an unverified read
+    static constexpr size_t max_read_retries_ = 1024;
+
+    // Runs `update` with the generation odd, so readers retry meanwhile.
+    void Update(auto&& update);
+
+    // writer pid << 32 | generation, swapped together so a takeover can't
+    // race the pid of a live writer
+    std::atomic<uint64_t> state_;
+    std::atomic<uint8_t> min_level_;
+    std::array<Override, max_overrides_> overrides_;
+    std::atomic<uint32_t> queue_shards_;
+};
@@ -1,12 +1,21 @@
 #include "logger.h"
 
+#include <pthread.h>
 #include <unistd.h>
 
 #include <algorithm>
 #include <chrono>
+#include <csignal>
+#include <cstring>
 #include <format>
 #include <iostream>
+#include <iterator>
+#include <queue>
+#include <tuple>
 #include <utility>
+#include <vector>
+
+#include "thread.h"
 
 using std::expected, std::unexpected, std::string_view;
 
@@ -18,36 +27,250 @@ constexpr void CopyStrToArray(string_view str, std::array<char, N>& array) {
     std::copy_n(str.begin(), len, array.begin());
     array.at(len) = '\0';
 }
+
+// Renders "%F %T" of a local time_point the way zoned_time does, including
+// the sub-second digits, but the date and time of day are only formatted
+// again when the second changes. The zone is resolved once per process.
+class TimestampCache {
+  public:
+    void Append(std::chrono::system_clock::time_point time, std::string& out) {
+        using std::chrono::floor, std::chrono::seconds;
+
+        const auto second = floor<seconds>(time);
+        if (prefix_len_ == 0 || second != second_) {
+            const auto rendered = std::format_to_n(
+                prefix_.data(), prefix_.size(), "{:%F %T}",
+                std::chrono::zoned_time(Zone(), second));
+            prefix_len_ = std::min(static_cast<size_t>(rendered.size),
+                                   prefix_.size());
+            second_ = second;
+        }
+        out.append(prefix_.data(), prefix_len_);
+
+        // the fraction is cheaper to patch in by hand than to format
+        constexpr int base = 10;
+        std::array<char, fraction_width_ + 1> fraction{'.'};
+        auto ticks = (time - second).count();
+        for (size_t digit = fraction_width_; digit > 0; --digit) {
+            fraction.at(digit) = static_cast<char>('0' + (ticks % base));
+            ticks /= base;
+        }
+        if constexpr (fraction_width_ > 0) {
+            out.append(fraction.data(), fraction.size());
+        }
+    }
+
+    static auto Zone() -> const std::chrono::time_zone* {
+        static const auto* zone = std::chrono::current_zone();
+        return zone;
+    }
+
+  private:
+    static constexpr size_t fraction_width_ = std::chrono::hh_mm_ss<
+        std::chrono::system_clock::duration>::fractional_width;
+
+    std::chrono::sys_seconds second_;
+    std::array<char, 32> prefix_{};  // NOLINT(readability-magic-numbers)
+    size_t prefix_len_ = 0;
+};
+
+constexpr string_view g_binary_log_magic = "DSWLOG01";
+constexpr size_t g_binary_log_buffer_size = 1 << 20;
+
+// The shard queue of this process, picked on first use and again after
+// Logger::ResetAfterFork.
+std::optional<expected<IpcMessageQueue, IpcError>> g_shard_queue;
 };  // namespace
 
 Logger::Logger(string_view name, IpcMessageQueue queue)
     : name_(), queue_(std::move(queue)) {
     CopyStrToArray(name, name_);
+    name_hash_ = LogLevels::SenderHash(Name());
+}
+
+Logger::Logger(string_view name, SharedMemory<LogRing> ring)
+    : name_(), ring_(std::move(ring)) {
+    CopyStrToArray(name, name_);
+    name_hash_ = LogLevels::SenderHash(Name());
+}
+
+Logger::~Logger() {
+    // spilled records go out first, but a stalled printer must not hang the
+    // exit: what is left after a short grace is dropped, and so is anything
+    // that doesn't fit afterwards
+    if (overflow_) {
+        auto& state = *overflow_;
+        const auto deadline = MonotonicClock::now() + exit_drain_timeout_;
+        state.mutex.Lock();
+        while (!DrainSpillLocked() && MonotonicClock::now() < deadline) {
+            state.mutex.Unlock();
+            if (!Thread::SleepFor(std::chrono::milliseconds(1))) {
+                state.mutex.Lock();
+                break;
+            }
+            state.mutex.Lock();
+        }
+        state.counters.dropped += state.ring_spill.size();
+        for (const auto& message : state.spill) {
+            state.counters.dropped += CountRecords(message);
+        }
+        state.ring_spill.clear();
+        state.spill.clear();
+        state.spill_size = 0;
+        state.policy = OverflowPolicy::DROP_NEWEST;
+        state.mutex.Unlock();
+    }
+    if (limits_) {
+        for (size_t format = 0; format < limits_->sites.size(); ++format) {
+            auto& site = limits_->sites.at(format);
+            if (site.suppressed != 0) {
+                ReportSuppressed(static_cast<LogFormatId>(format),
+                                 std::exchange(site.suppressed, 0));
+            }
+        }
+    }
+    Flush();
+    if (overflow_) {
+        ReportOverflows(true);
+        Flush();
+    }
 }
 
 auto Logger::Create(string_view name) -> expected<Logger, IpcError> {
-    static auto queue = IpcMessageQueue::Get(MsgQueueKey::MAIN);
+    // without the control block (older printer) nothing is filtered and
+    // there is a single queue
+    static auto levels =
+        SharedMemory<LogLevels>::Get(SharedMemoryKey::LOG_LEVELS);
+
+    auto logger = [&]() -> expected<Logger, IpcError> {
+        static auto ring =
+            SharedMemory<LogRing>::Get(SharedMemoryKey::LOGGER);
+        if (ring) {
+            auto ring_copy = ring->Copy();
+            if (!ring_copy) {
+                return unexpected(ring_copy.error());
+            }
+            return Logger(name, std::move(*ring_copy));
+        }
+
+        const auto& queue = ShardQueue(levels ? (*levels)->QueueShards() : 1);
+        if (!queue) {
+            return std::unexpected(queue.error());
+        }
+        return Logger(name, queue->Copy());
+    }();
+
+    if (logger && levels) {
+        auto levels_copy = levels->Copy();
+        if (!levels_copy) {
+            return unexpected(levels_copy.error());
+        }
+        logger->levels_.emplace(std::move(*levels_copy));
+    }
+
+    return logger;
+}
+
+auto Logger::ShardQueue(uint32_t shards)
+    -> const expected<IpcMessageQueue, IpcError>& {
+    if (!g_shard_queue) {
+        const auto shard = static_cast<size_t>(getpid()) % shards;
+        g_shard_queue.emplace(IpcMessageQueue::Get(QueueKey(shard)));
+    }
+    return *g_shard_queue;
+}
+
+auto Logger::ResetAfterFork() -> expected<void, IpcError> {
+    g_shard_queue.reset();
+    if (!queue_) {
+        return {};  // every process shares the ring
+    }
+
+    const auto& queue = ShardQueue(levels_ ? (*levels_)->QueueShards() : 1);
     if (!queue) {
-        return std::unexpected(queue.error());
+        return unexpected(queue.error());
     }
-    return Logger(name, queue->Copy());
+    queue_.emplace(queue->Copy());
+    return {};
+}
+
+auto Logger::QueueKey(size_t shard) -> MsgQueueKey {
+    return static_cast<MsgQueueKey>(static_cast<key_t>(MsgQueueKey::MAIN) +
+                                    static_cast<key_t>(shard));
 }
 
 void Logger::Log(LogLevel level, string_view msg) {
-    Payload payload{.level = level,
-                    .sender_pid = getpid(),
-                    .sender_name = name_,
-                    .msg = {},
-                    .time = std::chrono::system_clock::now()};
+    if (!Enabled(level)) {
+        return;
+    }
+    Send(Record{.level = level,
+                .format = LogFormatId::TEXT,
+                .sender_pid = getpid(),
+                .sender_name = Name(),
+                .msg = msg,
+                .time = std::chrono::system_clock::now()});
+}
 
-    CopyStrToArray(msg, payload.msg);
+void Logger::Send(const Record& record) {
+    if (ring_) {
+        const auto msg =
+            record.msg.substr(0, std::tuple_size_v<PayloadMsgT> - 1);
+        Payload payload{.level = record.level,
+                        .format = record.format,
+                        .msg_len = static_cast<uint8_t>(msg.size()),
+                        .sender_pid = record.sender_pid,
+                        .sender_name = name_,
+                        .msg = {},
+                        .time = record.time};
+        std::ranges::copy(msg, payload.msg.begin());
 
-    auto sent = queue_.Send(payload, MessageTypeId::LOGGER);
-    if (!sent) {
-        LogPrinter::PrintError(
-            string_view(name_),
-            std::format("Sending logs failed: {}", sent.error().what()));
+        Push(payload);
+    } else if (batch_) {
+        BufferRecord(record);
+    } else {
+        MessageBuffer<max_record_size_> buffer;
+        auto appended = AppendRecord(buffer, record);
+        (void)appended;  // sized for the longest record
+
+        Transmit(buffer);
+    }
+
+    // after the batch lock is released, the report goes through Send again
+    if (overflow_) {
+        ReportOverflows(false);
+    }
+}
+
+void Logger::SendArgs(LogLevel level, LogFormatId format,
+                      std::span<const int64_t> args) {
+    const auto bytes = std::as_bytes(args);
+    Send(Record{.level = level,
+                .format = format,
+                .sender_pid = getpid(),
+                .sender_name = Name(),
+                .msg = string_view(reinterpret_cast<const char*>(bytes.data()),
+                                   bytes.size()),
+                .time = std::chrono::system_clock::now()});
+}
+
+void Logger::Push(const Payload& payload) {
+    if (!overflow_) {
+        auto pushed = (*ring_)->Push(payload);
+        if (!pushed) {
+            LogPrinter::PrintError(
+                Name(),
+                std::format("Sending logs failed: {}", pushed.error().what()));
+        } else if (!*pushed) {
+            LogPrinter::PrintError(Name(), "Sending logs failed: interrupted");
+        }
+        return;
+    }
+
+    overflow_->mutex.Lock();
+    if (!DrainSpillLocked() || !(*ring_)->TryPush(payload)) {
+        OverflowLocked(payload);
     }
+    overflow_->mutex.Unlock();
 }
 
 void Logger::Debug(string_view msg) {
@@ -63,30 +286,484 @@ void Logger::Error(string_view msg) {
     Logger::Log(LogLevel::ERROR, msg);
 }
 
-LogPrinter::LogPrinter(IpcMessageQueue queue) : queue_(std::move(queue)) {}
+void Logger::EnableBatching(BatchPolicy policy) {
+    if (ring_ || batch_) {
+        return;
+    }
+    policy.max_records = std::max<size_t>(policy.max_records, 1);
+    batch_ = std::make_unique<BatchState>();
+    batch_->policy = policy;
+}
 
-auto LogPrinter::Create() -> expected<LogPrinter, IpcError> {
-    static auto queue = IpcMessageQueue::Create(MsgQueueKey::MAIN, 0666);
-    if (!queue) {
-        return unexpected(queue.error());
+void Logger::Flush() {
+    if (!batch_) {
+        return;
+    }
+    batch_->mutex.Lock();
+    FlushLocked();
+    batch_->mutex.Unlock();
+}
+
+void Logger::SetRateLimit(LogFormatId format, RateLimit limit) {
+    if (!limits_) {
+        limits_ = std::make_unique<LimitState>();
     }
+    const auto now = MonotonicClock::now();
+    limits_->sites.at(static_cast<size_t>(format)) =
+        SiteLimit{.limit = limit,
+                  .tokens = limit.burst,
+                  .sampled = 0,
+                  .suppressed = 0,
+                  .last_refill = now,
+                  .last_report = now};
+}
 
-    return LogPrinter(std::move(*queue));
+auto Logger::Admit(LogFormatId format) -> bool {
+    using std::chrono::duration;
+
+    limits_->mutex.Lock();
+    auto& site = limits_->sites.at(static_cast<size_t>(format));
+    if (!site.limit) {
+        limits_->mutex.Unlock();
+        return true;
+    }
+    const auto& limit = *site.limit;
+    const auto now = MonotonicClock::now();
+
+    bool admitted = limit.sample_every <= 1 ||
+                    site.sampled++ % limit.sample_every == 0;
+    if (admitted && limit.per_second > 0) {
+        const duration<double> elapsed = now - site.last_refill;
+        site.tokens = std::min(limit.burst,
+                               site.tokens + elapsed.count() * limit.per_second);
+        site.last_refill = now;
+        admitted = site.tokens >= 1;
+        if (admitted) {
+            site.tokens -= 1;
+        }
+    }
+    if (!admitted) {
+        site.suppressed++;
+    }
+
+    uint64_t report = 0;
+    if (site.suppressed != 0 && now - site.last_report >= limit.report_every) {
+        report = std::exchange(site.suppressed, 0);
+        site.last_report = now;
+    }
+    limits_->mutex.Unlock();
+
+    if (report != 0) {
+        ReportSuppressed(format, report);
+    }
+    return admitted;
 }
 
-auto LogPrinter::FormatLog(Logger::Payload log) -> std::string {
-    string_view msg(log.msg);
-    string_view sender(log.sender_name);
-    auto level = LogLevelToStr(log.level);
+void Logger::ReportSuppressed(LogFormatId format, uint64_t count) {
+    // SUPPRESSED_LINES could itself be limited, send it directly
+    if (!Enabled(LogLevel::INFO)) {
+        return;
+    }
+    const std::array<int64_t, 2> args{static_cast<int64_t>(count),
+                                      static_cast<int64_t>(format)};
+    SendArgs(LogLevel::INFO, LogFormatId::SUPPRESSED_LINES, args);
+}
 
-    auto local_time =
-        std::chrono::zoned_time(std::chrono::current_zone(), log.time);
+auto Logger::Name() const -> string_view {
+    return name_.data();
+}
 
-    return format("[{:%F %T}] {:>5} {}({}): {}\n", local_time, level, sender,
-                  log.sender_pid, msg);
+auto Logger::RefreshLevel() const -> uint64_t {
+    const auto [generation, level] = (*levels_)->Effective(name_hash_);
+    const auto cached = (static_cast<uint64_t>(generation) << 8U) | level;
+    level_cache_->store(cached, std::memory_order_relaxed);
+    return cached;
 }
 
-auto LogPrinter::LogLevelToStr(Logger::LogLevel level) -> std::string {
+void Logger::BufferRecord(const Record& record) {
+    batch_->mutex.Lock();
+
+    const auto now = MonotonicClock::now();
+    if (!AppendRecord(batch_->batch, record)) {
+        FlushLocked();
+        auto appended = AppendRecord(batch_->batch, record);
+        (void)appended;  // an empty batch fits any record
+    }
+    if (batch_->records++ == 0) {
+        batch_->oldest = now;
+    }
+
+    if (batch_->records >= batch_->policy.max_records ||
+        now - batch_->oldest >= batch_->policy.max_delay) {
+        FlushLocked();
+    }
+
+    batch_->mutex.Unlock();
+}
+
+void Logger::FlushLocked() {
+    Transmit(batch_->batch);
+    batch_->batch.Clear();
+    batch_->records = 0;
+}
+
+template <size_t Capacity>
+void Logger::Transmit(MessageBuffer<Capacity>& message) {
+    if (!overflow_) {
+        auto sent = queue_->SendBuffer(message, MessageTypeId::LOGGER);
+        if (!sent) {
+            LogPrinter::PrintError(
+                Name(),
+                std::format("Sending logs failed: {}", sent.error().what()));
+        }
+        return;
+    }
+
+    overflow_->mutex.Lock();
+    if (!DrainSpillLocked() || !TrySendLocked(message)) {
+        OverflowLocked(message);
+    }
+    overflow_->mutex.Unlock();
+}
+
+template <size_t Capacity>
+auto Logger::TrySendLocked(MessageBuffer<Capacity>& message) -> bool {
+    auto sent = queue_->SendBuffer(message, MessageTypeId::LOGGER, false);
+    if (sent) {
+        return true;
+    }
+    if (sent.error().code() == std::errc::resource_unavailable_try_again) {
+        return false;
+    }
+
+    LogPrinter::PrintError(
+        Name(), std::format("Sending logs failed: {}", sent.error().what()));
+    overflow_->counters.dropped += CountRecords(message.Bytes());
+    return true;
+}
+
+auto Logger::DrainSpillLocked() -> bool {
+    auto& state = *overflow_;
+
+    while (!state.ring_spill.empty()) {
+        if (!(*ring_)->TryPush(state.ring_spill.front())) {
+            return false;
+        }
+        state.ring_spill.pop_front();
+        state.spill_size -= sizeof(Payload);
+    }
+
+    while (!state.spill.empty()) {
+        const auto& message = state.spill.front();
+        state.scratch.Clear();
+        auto appended = state.scratch.Append(message);
+        (void)appended;  // spilled messages came from a RecordBatch at most
+
+        if (!TrySendLocked(state.scratch)) {
+            return false;
+        }
+        state.spill_size -= message.size();
+        state.spill.pop_front();
+    }
+
+    return true;
+}
+
+template <size_t Capacity>
+void Logger::OverflowLocked(MessageBuffer<Capacity>& message) {
+    auto& state = *overflow_;
+    const auto records = CountRecords(message.Bytes());
+
+    switch (state.policy) {
+        case OverflowPolicy::BLOCK: {
+            auto sent = queue_->SendBuffer(message, MessageTypeId::LOGGER);
+            if (!sent) {
+                state.counters.dropped += records;
+            }
+            return;
+        }
+        case OverflowPolicy::DROP_NEWEST:
+            state.counters.dropped += records;
+            return;
+        case OverflowPolicy::DROP_OLDEST: {
+            // take the oldest message away from the printer to make room
+            auto stolen = queue_->ReceiveBuffer(state.scratch,
+                                                MessageTypeId::LOGGER, false);
+            if (stolen) {
+                state.counters.dropped += CountRecords(state.scratch.Bytes());
+            }
+            if (!TrySendLocked(message)) {
+                state.counters.dropped += records;
+            }
+            return;
+        }
+        case OverflowPolicy::SPILL: {
+            const auto bytes = message.Bytes();
+            if (state.spill_size + bytes.size() > state.spill_limit) {
+                state.counters.dropped += records;
+                return;
+            }
+            state.spill.emplace_back(bytes.begin(), bytes.end());
+            state.spill_size += bytes.size();
+            state.counters.spilled += records;
+            return;
+        }
+    }
+}
+
+void Logger::OverflowLocked(const Payload& payload) {
+    auto& state = *overflow_;
+
+    switch (state.policy) {
+        case OverflowPolicy::BLOCK: {
+            auto pushed = (*ring_)->Push(payload);
+            if (!pushed) {
+                LogPrinter::PrintError(
+                    Name(), std::format("Sending logs failed: {}",
+                                        pushed.error().what()));
+            }
+            if (!pushed || !*pushed) {
+                state.counters.dropped++;
+            }
+            return;
+        }
+        case OverflowPolicy::DROP_NEWEST:
+            state.counters.dropped++;
+            return;
+        case OverflowPolicy::DROP_OLDEST:
+            // the ring's pop is CAS based, stealing from the printer is safe
+            if ((*ring_)->TryPop()) {
+                state.counters.dropped++;
+            }
+            if (!(*ring_)->TryPush(payload)) {
+                state.counters.dropped++;
+            }
+            return;
+        case OverflowPolicy::SPILL:
+            if (state.spill_size + sizeof(Payload) > state.spill_limit) {
+                state.counters.dropped++;
+                return;
+            }
+            state.ring_spill.push_back(payload);
+            state.spill_size += sizeof(Payload);
+            state.counters.spilled++;
+            return;
+    }
+}
+
+void Logger::SetOverflowPolicy(OverflowPolicy policy, size_t spill_limit,
+                               std::chrono::milliseconds report_every) {
+    if (!overflow_) {
+        overflow_ = std::make_unique<OverflowState>();
+        overflow_->last_report = MonotonicClock::now();
+    }
+    overflow_->policy = policy;
+    overflow_->spill_limit = spill_limit;
+    overflow_->report_every = report_every;
+}
+
+auto Logger::Overflows() const -> OverflowCounters {
+    if (!overflow_) {
+        return {};
+    }
+    overflow_->mutex.Lock();
+    const auto counters = overflow_->counters;
+    overflow_->mutex.Unlock();
+    return counters;
+}
+
+void Logger::ReportOverflows(bool force) {
+    auto& state = *overflow_;
+    state.mutex.Lock();
+    const auto now = MonotonicClock::now();
+    const OverflowCounters pending{
+        .dropped = state.counters.dropped - state.reported.dropped,
+        .spilled = state.counters.spilled - state.reported.spilled};
+    const bool due =
+        (pending.dropped != 0 || pending.spilled != 0) &&
+        (force || now - state.last_report >= state.report_every);
+    if (due) {
+        // marked before sending, the report itself may overflow
+        state.reported = state.counters;
+        state.last_report = now;
+    }
+    state.mutex.Unlock();
+
+    if (!due) {
+        return;
+    }
+    const std::array<int64_t, 2> args{static_cast<int64_t>(pending.dropped),
+                                      static_cast<int64_t>(pending.spilled)};
+    SendArgs(LogLevel::WARNING, LogFormatId::LOG_OVERFLOWS, args);
+}
+
+auto Logger::CountRecords(std::span<const std::byte> message) -> size_t {
+    size_t count = 0;
+    while (TakeRecord(message)) {
+        count++;
+    }
+    return count;
+}
+
+template <size_t Capacity>
+auto Logger::AppendRecord(MessageBuffer<Capacity>& buffer,
+                          const Record& record) -> bool {
+    // same limits as the fixed-size Payload arrays
+    const auto sender = record.sender_name.substr(
+        0, std::tuple_size_v<PayloadSenderT> - 1);
+    const auto msg =
+        record.msg.substr(0, std::tuple_size_v<PayloadMsgT> - 1);
+
+    const RecordHeader header{.time = record.time,
+                              .sender_pid = record.sender_pid,
+                              .level = record.level,
+                              .format = record.format,
+                              .sender_len = static_cast<uint8_t>(sender.size()),
+                              .msg_len = static_cast<uint8_t>(msg.size())};
+
+    if (sizeof(header) + sender.size() + msg.size() > buffer.Remaining()) {
+        return false;
+    }
+    return buffer.Append(std::as_bytes(std::span(&header, 1))) &&
+           buffer.Append(std::as_bytes(std::span(sender))) &&
+           buffer.Append(std::as_bytes(std::span(msg)));
+}
+
+auto Logger::TakeRecord(std::span<const std::byte>& bytes)
+    -> std::optional<Record> {
+    RecordHeader header;
+    if (bytes.size() < sizeof(header)) {
+        return std::nullopt;
+    }
+    std::memcpy(&header, bytes.data(), sizeof(header));
+
+    const size_t size = sizeof(header) + header.sender_len + header.msg_len;
+    if (bytes.size() < size) {
+        return std::nullopt;
+    }
+    const auto* chars =
+        reinterpret_cast<const char*>(bytes.data() + sizeof(header));
+    bytes = bytes.subspan(size);
+
+    return Record{.level = header.level,
+                  .format = header.format,
+                  .sender_pid = header.sender_pid,
+                  .sender_name = string_view(chars, header.sender_len),
+                  .msg = string_view(chars + header.sender_len, header.msg_len),
+                  .time = header.time};
+}
+
+auto Logger::ToRecord(const Payload& payload) -> Record {
+    return Record{.level = payload.level,
+                  .format = payload.format,
+                  .sender_pid = payload.sender_pid,
+                  .sender_name = payload.sender_name.data(),
+                  .msg = string_view(payload.msg.data(), payload.msg_len),
+                  .time = payload.time};
+}
+
+struct LogPrinter::MergeInbox {
+    struct Entry {
+        std::chrono::system_clock::time_point time;
+        uint64_t seq;
+        std::vector<std::byte> record;
+    };
+
+    ThreadMutex mutex;
+    std::vector<Entry> entries;
+    uint64_t next_seq = 0;
+};
+
+LogPrinter::LogPrinter(std::vector<IpcMessageQueue> queues)
+    : queues_(std::move(queues)) {}
+
+LogPrinter::LogPrinter(SharedMemory<Logger::LogRing> ring)
+    : ring_(std::move(ring)) {}
+
+auto LogPrinter::Create(const LogPrinterConfig& config)
+    -> expected<LogPrinter, std::system_error> {
+    const bool binary = !config.binary_path.empty();
+    std::unique_ptr<ReportWriter> writer;
+    if (binary || !config.report_path.empty()) {
+        auto created = ReportWriter::Create(
+            {.path = binary ? config.binary_path : config.report_path,
+             .rotate_size = config.rotate_size,
+             .header = binary ? std::string(g_binary_log_magic) : ""});
+        if (!created) {
+            return unexpected(created.error());
+        }
+        writer = std::move(*created);
+    }
+
+    // resolving the zone reads tzdata, better done before records arrive
+    (void)TimestampCache::Zone();
+
+    auto printer = [&]() -> expected<LogPrinter, std::system_error> {
+        if (config.transport == LogTransport::RING_BUFFER) {
+            auto ring = SharedMemory<Logger::LogRing>::Create(
+                SharedMemoryKey::LOGGER, 0666);
+            if (!ring) {
+                return unexpected(ring.error());
+            }
+            return LogPrinter(std::move(*ring));
+        }
+
+        const auto shards =
+            std::clamp<size_t>(config.queue_shards, 1, g_log_max_queue_shards);
+        std::vector<IpcMessageQueue> queues;
+        queues.reserve(shards);
+        for (size_t shard = 0; shard < shards; ++shard) {
+            auto queue =
+                IpcMessageQueue::Create(Logger::QueueKey(shard), 0666);
+            if (!queue) {
+                return unexpected(queue.error());
+            }
+            queues.push_back(std::move(*queue));
+        }
+
+        return LogPrinter(std::move(queues));
+    }();
+
+    auto levels = SharedMemory<LogLevels>::Create(SharedMemoryKey::LOG_LEVELS,
+                                                  0666);
+    if (!levels) {
+        return unexpected(levels.error());
+    }
+
+    if (printer) {
+        (*levels)->SetQueueShards(
+            static_cast<uint32_t>(std::max<size_t>(printer->queues_.size(), 1)));
+        printer->levels_.emplace(std::move(*levels));
+        printer->reorder_window_ = config.reorder_window;
+        printer->writer_ = std::move(writer);
+        printer->binary_ = binary;
+    }
+    return printer;
+}
+
+void LogPrinter::FormatLog(const Logger::Record& log, std::string& out) {
+    // one cache per thread, error lines are printed from any of them
+    thread_local TimestampCache timestamps;
+
+    out += '[';
+    timestamps.Append(log.time, out);
+    std::format_to(std::back_inserter(out), "] {:>5} {}({}): ",
+                   LogLevelToStr(log.level), log.sender_name, log.sender_pid);
+
+    if (log.format != LogFormatId::TEXT) {
+        std::array<int64_t, g_log_format_max_args> args{};
+        const auto count =
+            std::min(log.msg.size() / sizeof(int64_t), args.size());
+        std::memcpy(args.data(), log.msg.data(), count * sizeof(int64_t));
+
+        RenderLogFormat(log.format, std::span(args).first(count), out);
+    } else {
+        out += log.msg;
+    }
+    out += '\n';
+}
+
+auto LogPrinter::LogLevelToStr(Logger::LogLevel level) -> string_view {
     switch (level) {
         case Logger::DEBUG:
             return "DEBUG";
@@ -101,29 +778,281 @@ auto LogPrinter::LogLevelToStr(Logger::LogLevel level) -> std::string {
 }
 
 auto LogPrinter::ReceiveForever() -> expected<void, IpcError> {
+    // A signal handler can't wake a receiver that checked the flag and is
+    // about to block. SIGTERM/SIGINT are taken by a watcher thread instead,
+    // which raises the flag and then wakes the receiver.
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    auto watcher = Thread::Create([this, signals]() {
+        int signal = 0;
+        if (sigwait(&signals, &signal) == 0) {
+            CurrentProcess::RequestTermination();
+            WakeReceiver();
+        }
+    });
+    if (!watcher) {
+        PrintError("logger", watcher.error().what());
+        pthread_sigmask(SIG_UNBLOCK, &signals, nullptr);
+    }
+
+    auto received = ring_                ? ReceiveRingForever()
+                    : queues_.size() > 1 ? ReceiveShardsForever()
+                                         : ReceiveQueueForever();
+
+    if (watcher) {
+        auto cancelled = watcher->Cancel();
+        auto joined = watcher->Join();
+    }
+    return received;
+}
+
+void LogPrinter::WakeReceiver() {
+    if (ring_) {
+        (*ring_)->Interrupt();
+        return;
+    }
+    if (queues_.size() == 1) {
+        // ends the msgrcv, a full queue wakes the receiver anyway
+        auto sent = queues_.front().SendEmpty(MessageTypeId::LOGGER, false);
+    }
+    // the merging thread of the shards checks the flag every tick
+}
+
+auto LogPrinter::ReceiveQueueForever() -> expected<void, IpcError> {
+    Logger::RecordBatch batch;
     while (true) {
-        auto message = queue_.Receive<Logger::Payload>(MessageTypeId::LOGGER);
-        if (!message) {
-            if (message.error().code() == std::errc::interrupted) {
+        // once asked to stop, what is still queued is printed without
+        // waiting for more
+        const bool draining = CurrentProcess::TerminateReceived();
+        auto received = queues_.front().ReceiveBuffer(
+            batch, MessageTypeId::LOGGER, !draining);
+        if (!received) {
+            const auto error = received.error().code();
+            if (error == std::errc::no_message ||
+                error == std::errc::interrupted) {
                 return {};
             }
-            return unexpected(message.error());
+            return unexpected(received.error());
+        }
+        if (binary_) {
+            OutputBinary(batch.Bytes());
+            continue;
+        }
+        auto bytes = batch.Bytes();
+        while (auto record = Logger::TakeRecord(bytes)) {
+            Output(*record);
+        }
+    }
+}
+
+auto LogPrinter::ReceiveRingForever() -> expected<void, IpcError> {
+    // Pop only gives up once termination was requested
+    while (true) {
+        auto message = (*ring_)->Pop();
+        if (!message) {
+            PrintError("logger", message.error().what());
+            return {};
+        }
+        if (!*message) {
+            return {};
+        }
+        Output(Logger::ToRecord(**message));
+    }
+}
+
+auto LogPrinter::ReceiveShardsForever() -> expected<void, IpcError> {
+    MergeInbox inbox;
+    std::vector<Thread> threads;
+    for (const auto& queue : queues_) {
+        auto thread = Thread::Create([&queue, &inbox]() {
+            // termination is noticed by the merging thread, which wakes
+            // the shards to drain their queues and stop
+            sigset_t set;
+            sigfillset(&set);
+            pthread_sigmask(SIG_BLOCK, &set, nullptr);
+
+            ReceiveShard(queue, inbox);
+        });
+        if (!thread) {
+            PrintError("logger", thread.error().what());
+            break;
+        }
+        threads.push_back(*thread);
+    }
+
+    // k-way merge of the shards: records wait in a min-heap on time until
+    // they are older than the reorder window
+    const auto later = [](const MergeInbox::Entry& lhs,
+                          const MergeInbox::Entry& rhs) {
+        return std::tie(lhs.time, lhs.seq) > std::tie(rhs.time, rhs.seq);
+    };
+    std::priority_queue<MergeInbox::Entry, std::vector<MergeInbox::Entry>,
+                        decltype(later)>
+        pending(later);
+    std::vector<MergeInbox::Entry> taken;
+    const auto tick = std::min<std::chrono::milliseconds>(
+        std::max<std::chrono::milliseconds>(reorder_window_ / 4,
+                                            std::chrono::milliseconds(1)),
+        std::chrono::milliseconds(50));  // NOLINT
+
+    const auto merge = [&](std::chrono::system_clock::time_point until) {
+        inbox.mutex.Lock();
+        taken.swap(inbox.entries);
+        inbox.mutex.Unlock();
+
+        for (auto& entry : taken) {
+            pending.push(std::move(entry));
+        }
+        taken.clear();
+
+        while (!pending.empty() && pending.top().time <= until) {
+            OutputEncoded(pending.top().record);
+            pending.pop();
+        }
+    };
+
+    while (!CurrentProcess::TerminateReceived() && Thread::SleepFor(tick)) {
+        merge(std::chrono::system_clock::now() - reorder_window_);
+    }
+
+    // the shards drain their queues before they stop
+    for (const auto& queue : queues_) {
+        auto sent = queue.SendEmpty(MessageTypeId::LOGGER, false);
+    }
+    for (const auto& thread : threads) {
+        auto joined = thread.Join();
+    }
+    for (auto& queue : queues_) {
+        auto removed = queue.Remove();
+    }
+    merge(std::chrono::system_clock::time_point::max());
+
+    return {};
+}
+
+void LogPrinter::ReceiveShard(const IpcMessageQueue& queue,
+                              MergeInbox& inbox) {
+    Logger::RecordBatch batch;
+    while (true) {
+        const bool draining = CurrentProcess::TerminateReceived();
+        auto received =
+            queue.ReceiveBuffer(batch, MessageTypeId::LOGGER, !draining);
+        if (!received) {
+            const auto error = received.error().code();
+            if (error != std::errc::no_message &&
+                error != std::errc::identifier_removed &&
+                error != std::errc::invalid_argument) {
+                PrintError("logger", received.error().what());
+            }
+            return;
+        }
+
+        auto bytes = batch.Bytes();
+        inbox.mutex.Lock();
+        while (true) {
+            const auto rest = bytes;
+            auto record = Logger::TakeRecord(bytes);
+            if (!record) {
+                break;
+            }
+            const auto encoded = rest.first(rest.size() - bytes.size());
+            inbox.entries.push_back(
+                {.time = record->time,
+                 .seq = inbox.next_seq++,
+                 .record = {encoded.begin(), encoded.end()}});
+        }
+        inbox.mutex.Unlock();
+    }
+}
+
+void LogPrinter::OutputEncoded(std::span<const std::byte> record) {
+    if (binary_) {
+        OutputBinary(record);
+        return;
+    }
+    if (auto decoded = Logger::TakeRecord(record)) {
+        Output(*decoded);
+    }
+}
+
+void LogPrinter::Output(const Logger::Record& record) {
+    if (binary_) {
+        MessageBuffer<Logger::max_record_size_> buffer;
+        if (Logger::AppendRecord(buffer, record)) {
+            OutputBinary(buffer.Bytes());
+        }
+        return;
+    }
+
+    line_.clear();
+    FormatLog(record, line_);
+    if (writer_) {
+        writer_->Append(line_);
+    } else {
+        std::cout << line_;
+    }
+}
+
+void LogPrinter::OutputBinary(std::span<const std::byte> records) {
+    // records are already in file format, no parsing needed
+    writer_->Append(records);
+}
+
+auto LogPrinter::DecodeBinaryLog(std::FILE* input, std::ostream& output)
+    -> expected<void, std::system_error> {
+    std::array<char, g_binary_log_magic.size()> magic{};
+    if (std::fread(magic.data(), 1, magic.size(), input) != magic.size() ||
+        string_view(magic.data(), magic.size()) != g_binary_log_magic) {
+        return unexpected(std::system_error(
+            std::make_error_code(std::errc::illegal_byte_sequence),
+            "not a binary drone swarm log"));
+    }
+
+    // records may straddle chunks, leftovers move to the front
+    std::vector<std::byte> chunk(g_binary_log_buffer_size);
+    std::string text;
+    size_t leftover = 0;
+    while (true) {
+        const auto read =
+            std::fread(chunk.data() + leftover, 1, chunk.size() - leftover,
+                       input);
+        if (read == 0) {
+            break;
         }
-        const auto formatted = FormatLog(*message);
-        std::cout << formatted;
+
+        auto bytes = std::span<const std::byte>(chunk).first(leftover + read);
+        text.clear();
+        while (auto record = Logger::TakeRecord(bytes)) {
+            FormatLog(*record, text);
+        }
+        output << text;
+        std::memmove(chunk.data(), bytes.data(), bytes.size());
+        leftover = bytes.size();
     }
 
+    if (std::ferror(input) != 0) {
+        return unexpected(std::system_error(errno, std::generic_category()));
+    }
+    if (leftover != 0) {
+        return unexpected(std::system_error(
+            std::make_error_code(std::errc::illegal_byte_sequence),
+            "binary log ends with a truncated record"));
+    }
     return {};
 }
 
 void LogPrinter::PrintError(std::string_view sender, std::string_view msg) {
-    Logger::Payload payload{.level = Logger::ERROR,
-                            .sender_pid = getpid(),
-                            .sender_name = {},
-                            .msg = {},
-                            .time = std::chrono::system_clock::now()};
-    CopyStrToArray(msg, payload.msg);
-    CopyStrToArray(sender, payload.sender_name);
-    const auto formatted = FormatLog(payload);
+    const Logger::Record record{.level = Logger::ERROR,
+                                .format = LogFormatId::TEXT,
+                                .sender_pid = getpid(),
+                                .sender_name = sender,
+                                .msg = msg,
+                                .time = std::chrono::system_clock::now()};
+    std::string formatted;
+    FormatLog(record, formatted);
     std::cerr << formatted;
 }
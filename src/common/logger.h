@@ -4,23 +4,174 @@
 
 #include <array>
 #include <chrono>
+#include <concepts>
+#include <cstddef>
+#include <cstdio>
+#include <deque>
 #include <expected>
+#include <iosfwd>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
 
+#include "clock.h"
 #include "ipc/msg_queue.h"
+#include "ipc/ring_buffer.h"
+#include "ipc/shared_memory.h"
+#include "log_format.h"
+#include "log_levels.h"
+#include "report_writer.h"
+#include "thread_utils.h"
+
+// How log records get from Logger to LogPrinter. The printer picks one at
+// startup, loggers follow whatever the printer has set up.
+enum class LogTransport : uint8_t { MESSAGE_QUEUE, RING_BUFFER };
+
+// Message queue shards use the keys MsgQueueKey::MAIN + 0 .. max - 1.
+constexpr size_t g_log_max_queue_shards = 16;
+
+struct LogPrinterConfig {
+    LogTransport transport = LogTransport::MESSAGE_QUEUE;
+    // If set, raw records are appended to this file instead of text,
+    // logdecode renders it later. Takes precedence over report_path.
+    std::string binary_path;
+    // If set, text goes to this file instead of stdout.
+    std::string report_path;
+    // See ReportWriter::Config::rotate_size.
+    size_t rotate_size = 0;
+    // Message queue transport only. With more than one shard every queue
+    // gets its own receiving thread, senders pick a queue by pid and the
+    // printer merges records by time. Records are held back for
+    // `reorder_window` so late ones from another shard can overtake them,
+    // records later than that are printed as they come.
+    size_t queue_shards = 1;
+    std::chrono::milliseconds reorder_window{250};  // NOLINT
+};
 
 class Logger {
   public:
     enum LogLevel : uint8_t { DEBUG, INFO, WARNING, ERROR };
 
+    // Batched records are kept in the process and sent as one message once
+    // `max_records` are buffered or the next one doesn't fit, on the first
+    // Log after the oldest one is `max_delay` old, or on Flush. Only the
+    // message queue transport batches, the ring buffer has no per-record
+    // syscall to save.
+    struct BatchPolicy {
+        size_t max_records;
+        std::chrono::milliseconds max_delay;
+    };
+
+    // Limits one message site, i.e. one LogFormatId of this sender. Lines
+    // are first sampled 1-in-`sample_every`, then pass a token bucket
+    // refilled at `per_second` up to `burst` (per_second 0 disables it).
+    // Suppressed lines are counted and reported as a separate line at most
+    // every `report_every`, and once more when the Logger is destroyed.
+    struct RateLimit {
+        double per_second;
+        double burst;
+        uint32_t sample_every;
+        std::chrono::milliseconds report_every;
+    };
+
+    // What Log does when the queue or ring is full. Everything but BLOCK
+    // returns right away: DROP_NEWEST discards the new record, DROP_OLDEST
+    // discards the oldest queued message to make room, SPILL keeps records
+    // in the process (up to a byte limit, then drops) and resends them in
+    // order once there is room.
+    enum class OverflowPolicy : uint8_t {
+        BLOCK,
+        DROP_NEWEST,
+        DROP_OLDEST,
+        SPILL
+    };
+
+    struct OverflowCounters {
+        uint64_t dropped;
+        uint64_t spilled;
+    };
+
+    Logger(Logger&&) noexcept = default;
+    Logger(const Logger&) = delete;
+    auto operator=(Logger&&) -> Logger& = delete;
+    auto operator=(const Logger&) -> Logger& = delete;
+    ~Logger();
+
+    // Attaches to the ring buffer if the printer created one, falls back to
+    // the message queue otherwise.
     static auto Create(std::string_view name)
         -> std::expected<Logger, IpcError>;
 
+    // Cheap enough to call before building a message: one relaxed load of
+    // the shared level generation unless the levels changed.
+    [[nodiscard]] auto Enabled(LogLevel level) const -> bool {
+        if (!levels_) {
+            return true;
+        }
+        const auto generation = (*levels_)->Generation();
+        auto cached = level_cache_->load(std::memory_order_relaxed);
+        if (cached >> 8U != generation) {
+            cached = RefreshLevel();
+        }
+        return level >= (cached & 0xFFU);
+    }
+
     void Log(LogLevel level, std::string_view msg);
     void Debug(std::string_view msg);
     void Info(std::string_view msg);
     void Warning(std::string_view msg);
     void Error(std::string_view msg);
 
+    // Deferred formatting: only the format id and the arguments are sent,
+    // std::format runs in the logger process or in logdecode.
+    template <std::integral... Args>
+        requires(sizeof...(Args) <= g_log_format_max_args)
+    void Log(LogLevel level, LogFormatId format, Args... args) {
+        if (!Enabled(level) || (limits_ && !Admit(format))) {
+            return;
+        }
+        const std::array<int64_t, sizeof...(Args)> packed{
+            static_cast<int64_t>(args)...};
+        SendArgs(level, format, packed);
+    }
+    template <std::integral... Args>
+    void Debug(LogFormatId format, Args... args) {
+        Log(LogLevel::DEBUG, format, args...);
+    }
+    template <std::integral... Args>
+    void Info(LogFormatId format, Args... args) {
+        Log(LogLevel::INFO, format, args...);
+    }
+    template <std::integral... Args>
+    void Warning(LogFormatId format, Args... args) {
+        Log(LogLevel::WARNING, format, args...);
+    }
+    template <std::integral... Args>
+    void Error(LogFormatId format, Args... args) {
+        Log(LogLevel::ERROR, format, args...);
+    }
+
+    void EnableBatching(BatchPolicy policy);
+    void Flush();
+
+    // Call in the child of a fork without exec, before logging: picks the
+    // queue shard for the child's pid. Everything else is inherited as is.
+    [[nodiscard]] auto ResetAfterFork() -> std::expected<void, IpcError>;
+
+    // Meant for setup, before other threads use the Logger.
+    void SetRateLimit(LogFormatId format, RateLimit limit);
+
+    // Meant for setup, before other threads use the Logger. Counters that
+    // grew are logged at most every `report_every` while sending, and once
+    // more when the Logger is destroyed.
+    void SetOverflowPolicy(
+        OverflowPolicy policy, size_t spill_limit = 1 << 20,  // NOLINT
+        std::chrono::milliseconds report_every = std::chrono::seconds(1));
+    [[nodiscard]] auto Overflows() const -> OverflowCounters;
+
   private:
     using PayloadSenderT =
         std::array<char, 32>;  // NOLINT(readability-magic-numbers)
@@ -29,31 +180,193 @@ class Logger {
 
     struct Payload {
         LogLevel level{};
+        LogFormatId format{};
+        uint8_t msg_len{};
         pid_t sender_pid{};
         PayloadSenderT sender_name{};
         PayloadMsgT msg{};
         std::chrono::system_clock::time_point time;
     };
 
+    // Decoded view of a record, whichever transport it came through. For
+    // formatted records `msg` holds the packed int64_t arguments.
+    struct Record {
+        LogLevel level{};
+        LogFormatId format{};
+        pid_t sender_pid{};
+        std::string_view sender_name;
+        std::string_view msg;
+        std::chrono::system_clock::time_point time;
+    };
+
+    // Message queue and binary log wire format: the header followed by
+    // `sender_len` bytes of sender name and `msg_len` bytes of message, no
+    // terminators.
+    struct RecordHeader {
+        std::chrono::system_clock::time_point time;
+        pid_t sender_pid{};
+        LogLevel level{};
+        LogFormatId format{};
+        uint8_t sender_len{};
+        uint8_t msg_len{};
+    };
+    static_assert(sizeof(RecordHeader) == 16);
+
+    // how long the destructor keeps retrying spilled records
+    static constexpr auto exit_drain_timeout_ = std::chrono::milliseconds(200);
+
+    static constexpr size_t max_record_size_ =
+        sizeof(RecordHeader) + std::tuple_size_v<PayloadSenderT> +
+        std::tuple_size_v<PayloadMsgT>;
+
+    using LogRing =
+        RingBuffer<Payload, 4096>;  // NOLINT(readability-magic-numbers)
+
+    // msgmax defaults to 8192 bytes
+    using RecordBatch =
+        MessageBuffer<8192>;  // NOLINT(readability-magic-numbers)
+
+    struct BatchState {
+        BatchPolicy policy;
+        ThreadMutex mutex;
+        RecordBatch batch;
+        size_t records = 0;
+        MonotonicClock::time_point oldest;
+    };
+
+    struct SiteLimit {
+        std::optional<RateLimit> limit;
+        double tokens = 0;
+        uint32_t sampled = 0;
+        uint64_t suppressed = 0;
+        MonotonicClock::time_point last_refill;
+        MonotonicClock::time_point last_report;
+    };
+
+    struct LimitState {
+        ThreadMutex mutex;
+        std::array<SiteLimit, static_cast<size_t>(LogFormatId::COUNT)> sites;
+    };
+
+    struct OverflowState {
+        OverflowPolicy policy;
+        size_t spill_limit;
+        ThreadMutex mutex;
+        // message queue spill holds encoded messages, ring spill payloads
+        std::deque<std::vector<std::byte>> spill;
+        std::deque<Payload> ring_spill;
+        size_t spill_size = 0;
+        OverflowCounters counters{};
+        // counters as of the last LOG_OVERFLOWS line
+        OverflowCounters reported{};
+        std::chrono::milliseconds report_every;
+        MonotonicClock::time_point last_report;
+        RecordBatch scratch;
+    };
+
     explicit Logger(std::string_view name, IpcMessageQueue queue);
+    explicit Logger(std::string_view name, SharedMemory<LogRing> ring);
+
+    [[nodiscard]] static auto QueueKey(size_t shard) -> MsgQueueKey;
+    // The calling process's shard, the same for all its Loggers.
+    [[nodiscard]] static auto ShardQueue(uint32_t shards)
+        -> const std::expected<IpcMessageQueue, IpcError>&;
+
+    [[nodiscard]] auto Name() const -> std::string_view;
+    // Caches (generation << 8 | level) for this sender and returns it.
+    auto RefreshLevel() const -> uint64_t;
+
+    void Send(const Record& record);
+    void SendArgs(LogLevel level, LogFormatId format,
+                  std::span<const int64_t> args);
+    // Applies the site's rate limit, may log a suppression report.
+    [[nodiscard]] auto Admit(LogFormatId format) -> bool;
+    void ReportSuppressed(LogFormatId format, uint64_t count);
+    void BufferRecord(const Record& record);
+    void FlushLocked();
+
+    void Push(const Payload& payload);
+    template <size_t Capacity>
+    void Transmit(MessageBuffer<Capacity>& message);
+    // Sends without blocking. False if the queue is full, other errors are
+    // reported and count as drops.
+    template <size_t Capacity>
+    [[nodiscard]] auto TrySendLocked(MessageBuffer<Capacity>& message)
+        -> bool;
+    // Resends spilled records in order, gives up at the first full queue.
+    // Returns whether the spill is empty.
+    auto DrainSpillLocked() -> bool;
+    template <size_t Capacity>
+    void OverflowLocked(MessageBuffer<Capacity>& message);
+    void OverflowLocked(const Payload& payload);
+    // Logs the counts since the last report once `report_every` passed, or
+    // right away if `force`.
+    void ReportOverflows(bool force);
+    [[nodiscard]] static auto CountRecords(std::span<const std::byte> message)
+        -> size_t;
+
+    template <size_t Capacity>
+    [[nodiscard]] static auto AppendRecord(MessageBuffer<Capacity>& buffer,
+                                           const Record& record) -> bool;
+    // Decodes the record at the front of `bytes` and drops it from the span.
+    [[nodiscard]] static auto TakeRecord(std::span<const std::byte>& bytes)
+        -> std::optional<Record>;
+    [[nodiscard]] static auto ToRecord(const Payload& payload) -> Record;
 
     PayloadSenderT name_;
-    IpcMessageQueue queue_;
+    std::optional<IpcMessageQueue> queue_;
+    std::optional<SharedMemory<LogRing>> ring_;
+    std::unique_ptr<BatchState> batch_;
+    std::unique_ptr<LimitState> limits_;
+    std::unique_ptr<OverflowState> overflow_;
+    std::optional<SharedMemory<LogLevels>> levels_;
+    uint64_t name_hash_;
+    // all ones never matches a generation, forces the first refresh
+    std::unique_ptr<std::atomic<uint64_t>> level_cache_ =
+        std::make_unique<std::atomic<uint64_t>>(UINT64_MAX);
 
     friend class LogPrinter;
 };
 
 class LogPrinter {
   public:
-    static auto Create() -> std::expected<LogPrinter, IpcError>;
+    static auto Create(const LogPrinterConfig& config = {})
+        -> std::expected<LogPrinter, std::system_error>;
     auto ReceiveForever() -> std::expected<void, IpcError>;
 
     static void PrintError(std::string_view sender, std::string_view msg);
 
+    // Renders a binary log written with LogPrinterConfig::binary_path.
+    static auto DecodeBinaryLog(std::FILE* input, std::ostream& output)
+        -> std::expected<void, std::system_error>;
+
   private:
-    static auto FormatLog(Logger::Payload log) -> std::string;
-    static auto LogLevelToStr(Logger::LogLevel level) -> std::string;
+    // Records handed from the shard threads to the merging thread.
+    struct MergeInbox;
+
+    // Appends the rendered line to `out`.
+    static void FormatLog(const Logger::Record& log, std::string& out);
+    static auto LogLevelToStr(Logger::LogLevel level) -> std::string_view;
+
+    auto ReceiveQueueForever() -> std::expected<void, IpcError>;
+    auto ReceiveRingForever() -> std::expected<void, IpcError>;
+    auto ReceiveShardsForever() -> std::expected<void, IpcError>;
+    static void ReceiveShard(const IpcMessageQueue& queue, MergeInbox& inbox);
+    // Wakes whichever loop is receiving after termination was requested.
+    void WakeReceiver();
+    void Output(const Logger::Record& record);
+    void OutputBinary(std::span<const std::byte> records);
+    // Outputs one record in wire format.
+    void OutputEncoded(std::span<const std::byte> record);
 
-    explicit LogPrinter(IpcMessageQueue queue);
-    IpcMessageQueue queue_;
+    explicit LogPrinter(std::vector<IpcMessageQueue> queues);
+    explicit LogPrinter(SharedMemory<Logger::LogRing> ring);
+    std::vector<IpcMessageQueue> queues_;
+    std::optional<SharedMemory<Logger::LogRing>> ring_;
+    std::optional<SharedMemory<LogLevels>> levels_;
+    std::unique_ptr<ReportWriter> writer_;
+    bool binary_ = false;
+    std::chrono::milliseconds reorder_window_{};
+    // reused for every line, keeps Output free of allocations
+    std::string line_;
 };
@@ -2,9 +2,12 @@
 
 #include <fcntl.h>
 #include <pthread.h>
+#include <spawn.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <cerrno>
 #include <csignal>
 #include <system_error>
 #include <utility>
@@ -25,7 +28,10 @@ Process::Process(Process&& other) noexcept
     other.owner_ = false;
 }
 Process::~Process() {
-    auto signalled = Signal(SIGTERM);
+    // moved-from and borrowed processes are not ours to stop
+    if (owner_) {
+        auto signalled = Signal(SIGTERM);
+    }
 }
 
 auto Process::Create(std::initializer_list<const char*> args)
@@ -35,16 +41,31 @@ auto Process::Create(std::initializer_list<const char*> args)
 }
 auto Process::Create(std::span<const char*> args)
     -> std::expected<Process, std::system_error> {
-    auto process_id = fork();
+    const Spawner spawner;
+    auto process_id = spawner.Spawn(args);
+    if (!process_id) {
+        return std::unexpected(process_id.error());
+    }
 
-    if (process_id == 0) {
-        Exec(args);
-    } else if (process_id == -1) {
-        return std::unexpected(
-            std::system_error(errno, std::generic_category()));
+    return Process(*process_id, true);
+}
+
+auto Process::CreateMany(std::span<const std::vector<const char*>> commands)
+    -> std::expected<std::vector<Process>, std::system_error> {
+    // attributes and file actions are set up once for the whole batch
+    const Spawner spawner;
+    std::vector<Process> processes;
+    processes.reserve(commands.size());
+    for (const auto& args : commands) {
+        auto process_id = spawner.Spawn(args);
+        if (!process_id) {
+            // the ones already started are stopped with `processes`
+            return std::unexpected(process_id.error());
+        }
+        processes.push_back(Process(*process_id, true));
     }
 
-    return Process(process_id, true);
+    return processes;
 }
 
 auto Process::CreateWithPipe(std::initializer_list<const char*> args,
@@ -61,21 +82,29 @@ auto Process::CreateWithPipe(std::span<const char*> args, int pipe_fd)
             std::system_error(errno, std::generic_category()));
     }
 
-    auto process_id = fork();
-
-    if (process_id == 0) {
-        close(pipe_ends[0]);
-        dup2(pipe_ends[1], pipe_fd);
-        Exec(args, pipe_fd);
-    } else if (process_id == -1) {
+    auto process = CreateWithFd(args, pipe_ends[1], pipe_fd);
+    close(pipe_ends[1]);
+    if (!process) {
         close(pipe_ends[0]);
-        close(pipe_ends[1]);
-        return std::unexpected(
-            std::system_error(errno, std::generic_category()));
+        return std::unexpected(process.error());
     }
 
-    close(pipe_ends[1]);
-    return std::make_pair(PipeReader(pipe_ends[0]), Process(process_id, true));
+    return std::make_pair(PipeReader(pipe_ends[0]), std::move(*process));
+}
+
+auto Process::CreateWithFd(std::span<const char*> args, int fd, int child_fd)
+    -> std::expected<Process, std::system_error> {
+    const Spawner spawner(fd, child_fd);
+    auto process_id = spawner.Spawn(args);
+    if (!process_id) {
+        return std::unexpected(process_id.error());
+    }
+
+    return Process(*process_id, true);
+}
+
+auto Process::Adopt(pid_t process_id) -> Process {
+    return Process(process_id, true);
 }
 
 auto Process::CreateReady(std::initializer_list<const char*> args)
@@ -97,39 +126,56 @@ auto Process::CreateReady(std::span<const char*> args)
     return std::move(process);
 }
 
-void Process::Exec(std::span<const char*> args, int fd_to_keep) {
-    // close all but first 3 file descriptors
-    auto max_fd = sysconf(_SC_OPEN_MAX);
-    if (max_fd == -1) {
-        max_fd = 1024;  // fallback NOLINT(readability-magic-numbers)
-    }
-    for (int fd = 3; fd < max_fd; ++fd) {
-        if (fd == fd_to_keep) {
-            continue;
-        }
-        close(fd);
-    }
+Process::Spawner::Spawner(int pipe_src, int pipe_fd) {
+    posix_spawnattr_init(&attr_);
+    posix_spawn_file_actions_init(&actions_);
 
-    // clear signal masks
+    // children start with no signals blocked, whatever the spawning thread
+    // had
     sigset_t set;
     sigemptyset(&set);
-    if (pthread_sigmask(SIG_SETMASK, &set, nullptr) != 0) {
-        perror("pthread_sigmask failed");
-        _Exit(EXIT_FAILURE);
+    posix_spawnattr_setsigmask(&attr_, &set);
+    posix_spawnattr_setflags(&attr_, POSIX_SPAWN_SETSIGMASK);
+
+    // only stdio and the pipe survive, closefrom uses close_range(2)
+    // instead of a close per possible fd
+    int close_from = 3;
+    if (pipe_src != -1) {
+        posix_spawn_file_actions_adddup2(&actions_, pipe_src, pipe_fd);
+        for (int fd = close_from; fd < pipe_fd; ++fd) {
+            posix_spawn_file_actions_addclose(&actions_, fd);
+        }
+        close_from = std::max(close_from, pipe_fd + 1);
     }
+    posix_spawn_file_actions_addclosefrom_np(&actions_, close_from);
+}
 
+Process::Spawner::~Spawner() {
+    posix_spawn_file_actions_destroy(&actions_);
+    posix_spawnattr_destroy(&attr_);
+}
+
+auto Process::Spawner::Spawn(std::span<const char* const> args) const
+    -> std::expected<pid_t, std::system_error> {
     std::vector c_args(args.begin(), args.end());
     c_args.emplace_back(nullptr);
 
+    // glibc spawns through clone(CLONE_VM | CLONE_VFORK), so the parent's
+    // address space is never copied
+    pid_t process_id{};
     // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
-    auto ret = execvp(c_args[0], const_cast<char* const*>(c_args.data()));
-    if (ret == -1) {
-        perror("execvp failed");
-        _Exit(EXIT_FAILURE);
+    auto* const* argv = const_cast<char* const*>(c_args.data());
+    auto error = posix_spawnp(&process_id, c_args[0], &actions_, &attr_,
+                              argv, environ);
+    if (error != 0) {
+        return std::unexpected(
+            std::system_error(error, std::generic_category()));
     }
+
+    return process_id;
 }
 
-auto Process::TermWait() const -> std::expected<int, std::system_error> {
+auto Process::TermWait() -> std::expected<int, std::system_error> {
     if (auto success = Signal(SIGTERM); !success) {
         return std::unexpected(success.error());
     }
@@ -147,10 +193,26 @@ auto Process::Signal(int signal) const
     return {};
 }
 
-auto Process::Wait() const -> std::expected<int, std::system_error> {
+auto Process::Signal(int signal, int value) const
+    -> std::expected<void, std::system_error> {
+    if (sigqueue(process_id_, signal, sigval{.sival_int = value}) == -1) {
+        return std::unexpected(
+            std::system_error(errno, std::generic_category()));
+    }
+
+    return {};
+}
+
+auto Process::Wait() -> std::expected<int, std::system_error> {
     int status{};
 
-    waitpid(process_id_, &status, 0);
+    while (waitpid(process_id_, &status, 0) == -1) {
+        if (errno != EINTR) {
+            return std::unexpected(
+                std::system_error(errno, std::generic_category()));
+        }
+    }
+    owner_ = false;
 
     return status;
 }
@@ -195,11 +257,14 @@ auto CurrentProcess::SignalReady() -> std::expected<void, std::runtime_error> {
     return {};
 }
 
-// void CurrentProcess::RequestTermination() {
-//     terminate_sig_received_mut_.Lock();
-//     terminate_sig_received_ = 1;
-//     terminate_sig_received_mut_.Unlock();
-// }
+void CurrentProcess::ResetAfterFork() {
+    Get().process_id_ = getpid();
+    terminate_sig_received_ = 0;
+}
+
+void CurrentProcess::RequestTermination() {
+    terminate_sig_received_ = 1;
+}
 
 auto CurrentProcess::TerminateReceived() -> bool {
     // terminate_sig_received_mut_.Lock();
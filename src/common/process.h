@@ -1,9 +1,12 @@
 #pragma once
 
+#include <spawn.h>
+
 #include <csignal>
 #include <expected>
 #include <span>
 #include <system_error>
+#include <vector>
 
 #include "ipc/pipe.h"
 // #include "thread_utils.h"
@@ -24,6 +27,12 @@ class Process {
     static auto Create(std::span<const char*> args)
         -> std::expected<Process, std::system_error>;
 
+    // Starts one process per command, stops the ones already started if
+    // one fails.
+    [[nodiscard]]
+    static auto CreateMany(std::span<const std::vector<const char*>> commands)
+        -> std::expected<std::vector<Process>, std::system_error>;
+
     [[nodiscard]]
     static auto CreateWithPipe(std::initializer_list<const char*> args,
                                int pipe_fd = STDOUT_FILENO)
@@ -33,6 +42,16 @@ class Process {
                                int pipe_fd = STDOUT_FILENO)
         -> std::expected<std::pair<PipeReader, Process>, std::system_error>;
 
+    // Gives the child `fd` as `child_fd`, the caller keeps its own copy.
+    [[nodiscard]]
+    static auto CreateWithFd(std::span<const char*> args, int fd, int child_fd)
+        -> std::expected<Process, std::system_error>;
+
+    // Owns a child started some other way, e.g. an orphan of another child
+    // reparented to this child subreaper.
+    [[nodiscard]]
+    static auto Adopt(pid_t process_id) -> Process;
+
     [[nodiscard]]
     static auto CreateReady(std::initializer_list<const char*> args)
         -> std::expected<Process, std::system_error>;
@@ -40,19 +59,48 @@ class Process {
     static auto CreateReady(std::span<const char*> args)
         -> std::expected<Process, std::system_error>;
 
-    [[nodiscard]] auto TermWait() const
-        -> std::expected<int, std::system_error>;
+    [[nodiscard]] auto TermWait() -> std::expected<int, std::system_error>;
     [[nodiscard]] auto Signal(int signal) const
         -> std::expected<void, std::system_error>;
-    [[nodiscard]] auto Wait() const -> std::expected<int, std::system_error>;
+    // sigqueue with `value` as payload. Real-time signals sent this way are
+    // queued instead of merged, so each one is delivered exactly once. Fails
+    // with EAGAIN once the receiver's RLIMIT_SIGPENDING is reached.
+    [[nodiscard]] auto Signal(int signal, int value) const
+        -> std::expected<void, std::system_error>;
+    // Returns the raw wait status. A reaped process is no longer owned, its
+    // pid may already belong to someone else.
+    [[nodiscard]] auto Wait() -> std::expected<int, std::system_error>;
+
+    [[nodiscard]] auto Pid() const -> pid_t {
+        return process_id_;
+    }
 
     static auto WaitReady(PipeReader& pipe)
         -> std::expected<void, std::system_error>;
 
   private:
+    friend class CurrentProcess;
+
     explicit Process(pid_t process_id, bool joinable);
 
-    static void Exec(std::span<const char*> args, int fd_to_keep = 0);
+    // posix_spawn attributes and file actions, reusable for many spawns.
+    // With a pipe, `pipe_src` becomes the child's `pipe_fd`.
+    class Spawner {
+      public:
+        explicit Spawner(int pipe_src = -1, int pipe_fd = -1);
+        Spawner(Spawner&&) = delete;
+        Spawner(const Spawner&) = delete;
+        auto operator=(Spawner&&) -> Spawner& = delete;
+        auto operator=(const Spawner&) -> Spawner& = delete;
+        ~Spawner();
+
+        [[nodiscard]] auto Spawn(std::span<const char* const> args) const
+            -> std::expected<pid_t, std::system_error>;
+
+      private:
+        posix_spawnattr_t attr_{};
+        posix_spawn_file_actions_t actions_{};
+    };
 
     pid_t process_id_{};
 
@@ -71,8 +119,12 @@ class CurrentProcess : public Process {
 
     static void AddHandler(int signal, void (*handler)(int));
     static auto SignalReady() -> std::expected<void, std::runtime_error>;
-    // static void RequestTermination();
+    // Raises the flag the SIGTERM/SIGINT handler sets, for a signal that was
+    // taken with sigwait instead.
+    static void RequestTermination();
     static auto TerminateReceived() -> bool;
+    // Call in the child of a fork without exec, the pid was the parent's.
+    static void ResetAfterFork();
 
   private:
     static volatile sig_atomic_t terminate_sig_received_;
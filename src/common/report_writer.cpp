@@ -0,0 +1,198 @@
+#include "report_writer.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <climits>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <format>
+#include <utility>
+
+#include "logger.h"
+
+using std::expected, std::unexpected;
+
+namespace {
+constexpr size_t g_chunk_size = 64 * 1024;
+}  // namespace
+
+ReportWriter::ReportWriter(Config config, int file_descriptor)
+    : config_(std::move(config)), fd_(file_descriptor) {}
+
+ReportWriter::~ReportWriter() {
+    mutex_.Lock();
+    stop_ = true;
+    changed_.Broadcast();
+    mutex_.Unlock();
+
+    if (thread_) {
+        auto joined = thread_->Join();
+    }
+    if (fd_ != -1) {
+        close(fd_);
+    }
+}
+
+auto ReportWriter::Create(Config config)
+    -> expected<std::unique_ptr<ReportWriter>, std::system_error> {
+    auto writer =
+        std::unique_ptr<ReportWriter>(new ReportWriter(std::move(config), -1));
+    if (auto opened = writer->Open(); !opened) {
+        return unexpected(opened.error());
+    }
+
+    auto* raw_writer = writer.get();
+    auto thread = Thread::Create([raw_writer]() {
+        // signals are for the receiving thread, the writer only stops when
+        // the ReportWriter is destroyed
+        sigset_t set;
+        sigfillset(&set);
+        pthread_sigmask(SIG_BLOCK, &set, nullptr);
+
+        raw_writer->WriteForever();
+    });
+    if (!thread) {
+        return unexpected(thread.error());
+    }
+    writer->thread_ = *thread;
+
+    return writer;
+}
+
+void ReportWriter::Append(std::span<const std::byte> bytes) {
+    mutex_.Lock();
+    const bool was_empty = front_.empty();
+
+    while (!bytes.empty()) {
+        if (front_.empty() || front_.back().size() == g_chunk_size) {
+            if (free_.empty()) {
+                front_.emplace_back().reserve(g_chunk_size);
+            } else {
+                front_.push_back(std::move(free_.back()));
+                free_.pop_back();
+            }
+        }
+        auto& chunk = front_.back();
+        const auto count = std::min(bytes.size(), g_chunk_size - chunk.size());
+        chunk.insert(chunk.end(), bytes.begin(), bytes.begin() + count);
+        bytes = bytes.subspan(count);
+    }
+
+    if (was_empty) {
+        changed_.Broadcast();
+    }
+    mutex_.Unlock();
+}
+
+void ReportWriter::Append(std::string_view text) {
+    Append(std::as_bytes(std::span(text)));
+}
+
+void ReportWriter::WriteForever() {
+    std::vector<Chunk> back;
+
+    mutex_.Lock();
+    while (true) {
+        while (front_.empty() && !stop_) {
+            changed_.Wait(mutex_);
+        }
+        if (front_.empty() && stop_) {
+            break;
+        }
+        std::swap(front_, back);
+        mutex_.Unlock();
+
+        WriteChunks(back);
+        if (config_.rotate_size != 0 && file_size_ >= config_.rotate_size) {
+            Rotate();
+        }
+
+        mutex_.Lock();
+        for (auto& chunk : back) {
+            chunk.clear();
+            free_.push_back(std::move(chunk));
+        }
+        back.clear();
+    }
+    mutex_.Unlock();
+}
+
+void ReportWriter::WriteChunks(std::span<const Chunk> chunks) {
+    std::vector<iovec> iovecs;
+    iovecs.reserve(chunks.size());
+    for (const auto& chunk : chunks) {
+        iovecs.push_back(
+            {.iov_base = const_cast<std::byte*>(  // NOLINT
+                 chunk.data()),
+             .iov_len = chunk.size()});
+    }
+
+    std::span<iovec> pending(iovecs);
+    while (!pending.empty()) {
+        const auto count = std::min<size_t>(pending.size(), IOV_MAX);
+        auto written = writev(fd_, pending.data(), static_cast<int>(count));
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LogPrinter::PrintError(
+                "report",
+                std::format("Writing {} failed: {}", config_.path,
+                            std::system_error(errno, std::generic_category())
+                                .what()));
+            return;
+        }
+        file_size_ += static_cast<size_t>(written);
+
+        // drop fully written vectors, trim a partially written one
+        auto left = static_cast<size_t>(written);
+        while (!pending.empty() && left >= pending.front().iov_len) {
+            left -= pending.front().iov_len;
+            pending = pending.subspan(1);
+        }
+        if (!pending.empty()) {
+            pending.front().iov_base =
+                static_cast<std::byte*>(pending.front().iov_base) + left;
+            pending.front().iov_len -= left;
+        }
+    }
+}
+
+void ReportWriter::Rotate() {
+    close(fd_);
+    fd_ = -1;
+
+    const auto rotated = std::format("{}.{}", config_.path, ++rotations_);
+    if (std::rename(config_.path.c_str(), rotated.c_str()) == -1) {
+        LogPrinter::PrintError("report",
+                               std::format("Rotating {} failed", config_.path));
+    }
+
+    if (auto opened = Open(); !opened) {
+        LogPrinter::PrintError("report", opened.error().what());
+    }
+}
+
+auto ReportWriter::Open() -> expected<void, std::system_error> {
+    fd_ = open(config_.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+               0644);
+    if (fd_ == -1) {
+        return unexpected(
+            std::system_error(errno, std::generic_category(), config_.path));
+    }
+    file_size_ = 0;
+
+    if (!config_.header.empty()) {
+        const Chunk header(
+            reinterpret_cast<const std::byte*>(config_.header.data()),
+            reinterpret_cast<const std::byte*>(config_.header.data() +
+                                               config_.header.size()));
+        WriteChunks(std::span(&header, 1));
+    }
+    return {};
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <expected>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "thread.h"
+#include "thread_utils.h"
+
+// Appends to a report file from a dedicated thread, so callers never wait
+// for the disk. Appends go into a front list of fixed-size chunks; the
+// writer thread swaps it with the back list and writes that out with
+// writev while the front keeps filling up. The front grows as needed
+// instead of blocking when storage is slow.
+class ReportWriter {
+  public:
+    struct Config {
+        std::string path;
+        // Once a file reaches this size it is renamed to path.1, path.2, ...
+        // and a new one is started. 0 disables rotation.
+        size_t rotate_size = 0;
+        // Written at the start of every file, e.g. a binary log magic.
+        std::string header;
+    };
+
+    ReportWriter(ReportWriter&&) = delete;
+    ReportWriter(const ReportWriter&) = delete;
+    auto operator=(ReportWriter&&) -> ReportWriter& = delete;
+    auto operator=(const ReportWriter&) -> ReportWriter& = delete;
+    // Writes out everything appended so far.
+    ~ReportWriter();
+
+    [[nodiscard]]
+    static auto Create(Config config)
+        -> std::expected<std::unique_ptr<ReportWriter>, std::system_error>;
+
+    void Append(std::span<const std::byte> bytes);
+    void Append(std::string_view text);
+
+  private:
+    using Chunk = std::vector<std::byte>;
+
+    explicit ReportWriter(Config config, int file_descriptor);
+
+    void WriteForever();
+    void WriteChunks(std::span<const Chunk> chunks);
+    void Rotate();
+    [[nodiscard]] auto Open() -> std::expected<void, std::system_error>;
+
+    Config config_;
+    int fd_;
+    size_t file_size_ = 0;
+    size_t rotations_ = 0;
+
+    ThreadMutex mutex_;
+    ThreadCond changed_;
+    std::vector<Chunk> front_;
+    std::vector<Chunk> free_;
+    bool stop_ = false;
+    std::optional<Thread> thread_;
+};
@@ -0,0 +1,233 @@
+#include "supervisor.h"
+
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <csignal>
+#include <span>
+#include <unordered_set>
+#include <utility>
+
+#include "clock.h"
+
+using std::expected, std::unexpected;
+
+namespace {
+auto Errno() -> std::system_error {
+    return {errno, std::generic_category()};
+}
+
+// How a zombie child exited, without reaping it.
+auto Peek(pid_t pid) -> expected<ChildExit, std::system_error> {
+    siginfo_t info{};
+    while (waitid(P_PID, static_cast<id_t>(pid), &info, WEXITED | WNOWAIT) ==
+           -1) {
+        if (errno != EINTR) {
+            return unexpected(Errno());
+        }
+    }
+    if (info.si_code == CLD_KILLED || info.si_code == CLD_DUMPED) {
+        return ChildExit{.pid = pid,
+                         .reason = ChildExit::Reason::KILLED,
+                         .code = info.si_status};
+    }
+    return ChildExit{.pid = pid,
+                     .reason = ChildExit::Reason::EXITED,
+                     .code = info.si_status};
+}
+
+constexpr size_t g_supervisor_max_events = 64;
+
+// raw syscalls, older glibc headers don't declare these for C++
+auto PidFdOpen(pid_t pid) -> int {
+    return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+}
+
+auto PidFdSendSignal(int pidfd, int signal) -> int {
+    return static_cast<int>(
+        syscall(SYS_pidfd_send_signal, pidfd, signal, nullptr, 0));
+}
+}  // namespace
+
+Supervisor::Supervisor(int epoll_fd) : epoll_fd_(epoll_fd) {}
+
+Supervisor::Supervisor(Supervisor&& other) noexcept
+    : epoll_fd_(other.epoll_fd_),
+      signal_fd_(other.signal_fd_),
+      children_(std::move(other.children_)) {
+    other.epoll_fd_ = -1;
+    other.signal_fd_ = -1;
+    other.children_.clear();
+}
+
+Supervisor::~Supervisor() {
+    // the children themselves are stopped by their Process
+    for (const auto& [pidfd, child] : children_) {
+        close(pidfd);
+    }
+    if (signal_fd_ != -1) {
+        close(signal_fd_);
+    }
+    if (epoll_fd_ != -1) {
+        close(epoll_fd_);
+    }
+}
+
+auto Supervisor::Create() -> expected<Supervisor, std::system_error> {
+    const int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd == -1) {
+        return unexpected(Errno());
+    }
+    return Supervisor(epoll_fd);
+}
+
+auto Supervisor::Watch(Process process, ExitCallback on_exit)
+    -> expected<void, std::system_error> {
+    const int pidfd = PidFdOpen(process.Pid());
+    if (pidfd == -1) {
+        return unexpected(Errno());
+    }
+
+    epoll_event event{.events = EPOLLIN, .data = {.fd = pidfd}};
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, pidfd, &event) == -1) {
+        auto error = Errno();
+        close(pidfd);
+        return unexpected(error);
+    }
+
+    const auto group = getpgid(process.Pid());
+    children_.emplace(pidfd, Child{.process = std::move(process),
+                                   .group = group,
+                                   .on_exit = std::move(on_exit)});
+    return {};
+}
+
+auto Supervisor::StopOn(std::initializer_list<int> signals)
+    -> expected<void, std::system_error> {
+    sigset_t set;
+    sigemptyset(&set);
+    for (const int signal : signals) {
+        sigaddset(&set, signal);
+    }
+    if (pthread_sigmask(SIG_BLOCK, &set, nullptr) != 0) {
+        return unexpected(Errno());
+    }
+
+    const int signal_fd = signalfd(signal_fd_, &set, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signal_fd == -1) {
+        return unexpected(Errno());
+    }
+    if (signal_fd_ == -1) {
+        epoll_event event{.events = EPOLLIN, .data = {.fd = signal_fd}};
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, signal_fd, &event) == -1) {
+            auto error = Errno();
+            close(signal_fd);
+            return unexpected(error);
+        }
+        signal_fd_ = signal_fd;
+    }
+    return {};
+}
+
+auto Supervisor::Poll(std::optional<std::chrono::milliseconds> timeout)
+    -> expected<size_t, std::system_error> {
+    std::array<epoll_event, g_supervisor_max_events> events{};
+    const int ready =
+        epoll_wait(epoll_fd_, events.data(), static_cast<int>(events.size()),
+                   timeout ? static_cast<int>(timeout->count()) : -1);
+    if (ready == -1) {
+        if (errno == EINTR) {
+            return 0;
+        }
+        return unexpected(Errno());
+    }
+
+    size_t reaped = 0;
+    for (const auto& event : std::span(events).first(ready)) {
+        if (event.data.fd == signal_fd_) {
+            signalfd_siginfo info{};
+            while (read(signal_fd_, &info, sizeof(info)) == sizeof(info)) {
+                CurrentProcess::RequestTermination();
+            }
+            continue;
+        }
+        if (auto done = Reap(event.data.fd); !done) {
+            return unexpected(done.error());
+        }
+        ++reaped;
+    }
+    return reaped;
+}
+
+auto Supervisor::Reap(int pidfd) -> expected<void, std::system_error> {
+    auto node = children_.extract(pidfd);
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, pidfd, nullptr);
+    close(pidfd);
+
+    // readable pidfd, the child is a zombie and none of this blocks
+    auto& child = node.mapped();
+    auto exit = Peek(child.process.Pid());
+    if (!exit) {
+        return unexpected(exit.error());
+    }
+    if (child.on_exit) {
+        try {
+            child.on_exit(*exit);
+        } catch (...) {
+            // reaped anyway, the child would otherwise stay a zombie
+            auto status = child.process.Wait();
+            throw;
+        }
+    }
+    if (auto status = child.process.Wait(); !status) {
+        return unexpected(status.error());
+    }
+    return {};
+}
+
+void Supervisor::SignalAll(int signal) const {
+    const auto own_group = getpgrp();
+    std::unordered_set<pid_t> signalled;
+    for (const auto& [pidfd, child] : children_) {
+        if (child.group > 0 && child.group != own_group) {
+            // a whole group takes one kill
+            if (signalled.insert(child.group).second) {
+                kill(-child.group, signal);
+            }
+        } else {
+            PidFdSendSignal(pidfd, signal);
+        }
+    }
+}
+
+auto Supervisor::Shutdown(std::chrono::milliseconds grace)
+    -> expected<void, std::system_error> {
+    using std::chrono::duration_cast, std::chrono::milliseconds;
+
+    SignalAll(SIGTERM);
+    const auto deadline = MonotonicClock::now() + grace;
+    while (!children_.empty()) {
+        const auto left = duration_cast<milliseconds>(
+            deadline - MonotonicClock::now());
+        if (left <= milliseconds::zero()) {
+            break;
+        }
+        if (auto polled = Poll(left); !polled) {
+            return unexpected(polled.error());
+        }
+    }
+
+    SignalAll(SIGKILL);
+    while (!children_.empty()) {
+        if (auto polled = Poll(); !polled) {
+            return unexpected(polled.error());
+        }
+    }
+    return {};
+}
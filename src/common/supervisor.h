@@ -0,0 +1,91 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <chrono>
+#include <cstdint>
+#include <expected>
+#include <functional>
+#include <initializer_list>
+#include <optional>
+#include <system_error>
+#include <unordered_map>
+
+#include "process.h"
+
+struct ChildExit {
+    // NOLINTNEXTLINE(performance-enum-size)
+    enum class Reason : uint8_t { EXITED, KILLED };
+
+    pid_t pid;
+    Reason reason;
+    // exit status when EXITED, the signal when KILLED
+    int code;
+};
+
+// Watches any number of children through pidfds in one epoll set. Poll
+// reaps exactly the children that died and hands each to its callback, so
+// there is no per-child waitpid and no SIGCHLD handling. Callbacks run
+// before the child is reaped, while its pid can't be reused yet, and may
+// Watch replacements right away. A child whose callback throws is still
+// reaped.
+class Supervisor {
+  public:
+    using ExitCallback = std::function<void(const ChildExit&)>;
+
+    Supervisor(Supervisor&& other) noexcept;
+    Supervisor(const Supervisor&) = delete;
+    auto operator=(Supervisor&&) -> Supervisor& = delete;
+    auto operator=(const Supervisor&) -> Supervisor& = delete;
+    ~Supervisor();
+
+    [[nodiscard]]
+    static auto Create() -> std::expected<Supervisor, std::system_error>;
+
+    [[nodiscard]]
+    auto Watch(Process process, ExitCallback on_exit)
+        -> std::expected<void, std::system_error>;
+
+    // Blocks `signals` in the calling thread and takes them through a
+    // signalfd in the epoll set instead: Poll returns when one arrives, and
+    // termination is requested from CurrentProcess. With the handler alone,
+    // a signal that came between checking the flag and epoll_wait would
+    // only be noticed once a child exits.
+    [[nodiscard]]
+    auto StopOn(std::initializer_list<int> signals)
+        -> std::expected<void, std::system_error>;
+
+    // Waits up to `timeout`, forever without one, and returns how many
+    // children were reaped. A signal ends the wait early with 0.
+    [[nodiscard]]
+    auto Poll(std::optional<std::chrono::milliseconds> timeout = std::nullopt)
+        -> std::expected<size_t, std::system_error>;
+
+    // SIGTERM to every watched process group, or to the child itself when
+    // it shares ours, then SIGKILL to whatever outlives `grace`. Exit
+    // callbacks still run.
+    [[nodiscard]]
+    auto Shutdown(std::chrono::milliseconds grace)
+        -> std::expected<void, std::system_error>;
+
+    [[nodiscard]] auto Size() const -> size_t {
+        return children_.size();
+    }
+
+  private:
+    struct Child {
+        Process process;
+        pid_t group;
+        ExitCallback on_exit;
+    };
+
+    explicit Supervisor(int epoll_fd);
+
+    void SignalAll(int signal) const;
+    auto Reap(int pidfd) -> std::expected<void, std::system_error>;
+
+    int epoll_fd_;
+    int signal_fd_ = -1;
+    // by pidfd
+    std::unordered_map<int, Child> children_;
+};
@@ -2,6 +2,9 @@
 
 #include <pthread.h>
 
+#include <cerrno>
+#include <chrono>
+
 void ThreadMutex::Lock() {
     pthread_mutex_lock(&mutex_);
 }
@@ -9,9 +12,29 @@ void ThreadMutex::Unlock() {
     pthread_mutex_unlock(&mutex_);
 }
 
+ThreadCond::ThreadCond() {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&cond_, &attr);
+    pthread_condattr_destroy(&attr);
+}
+ThreadCond::~ThreadCond() {
+    pthread_cond_destroy(&cond_);
+}
+
 void ThreadCond::Broadcast() {
     pthread_cond_broadcast(&cond_);
 }
 void ThreadCond::Wait(ThreadMutex& mutex) {
     pthread_cond_wait(&cond_, &mutex.mutex_);
 }
+auto ThreadCond::WaitUntil(ThreadMutex& mutex,
+                           MonotonicClock::time_point deadline) -> bool {
+    const auto since_epoch = deadline.time_since_epoch();
+    const auto sec =
+        std::chrono::duration_cast<std::chrono::seconds>(since_epoch);
+    const timespec tspec{.tv_sec = sec.count(),
+                         .tv_nsec = (since_epoch - sec).count()};
+    return pthread_cond_timedwait(&cond_, &mutex.mutex_, &tspec) != ETIMEDOUT;
+}
@@ -2,6 +2,10 @@
 
 #include <pthread.h>
 
+#include <chrono>
+
+#include "clock.h"
+
 class ThreadMutex {
   public:
     ThreadMutex() = default;
@@ -20,18 +24,31 @@ class ThreadMutex {
     friend class ThreadCond;
 };
 
+// Timed waits use CLOCK_MONOTONIC, deadlines are MonotonicClock ones.
 class ThreadCond {
   public:
-    ThreadCond() = default;
+    ThreadCond();
     ThreadCond(ThreadCond &&) = delete;
     ThreadCond(const ThreadCond &) = delete;
     auto operator=(ThreadCond &&) = delete;
     auto operator=(const ThreadCond &) -> ThreadCond & = delete;
-    ~ThreadCond() = default;
+    ~ThreadCond();
 
     void Broadcast();
     void Wait(ThreadMutex &mutex);
+    // Returns false if `deadline` passed first.
+    auto WaitUntil(ThreadMutex &mutex, MonotonicClock::time_point deadline)
+        -> bool;
+
+    template <class Rep, class Period>
+    auto WaitFor(ThreadMutex &mutex,
+                 const std::chrono::duration<Rep, Period> &dur) -> bool {
+        return WaitUntil(
+            mutex, MonotonicClock::now() +
+                       std::chrono::duration_cast<MonotonicClock::duration>(
+                           dur));
+    }
 
   private:
-    pthread_cond_t cond_ = PTHREAD_COND_INITIALIZER;
+    pthread_cond_t cond_{};
 };
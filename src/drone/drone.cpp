@@ -1,12 +1,26 @@
+#include <pthread.h>
+
 #include <algorithm>
+#include <cstdint>
 #include <csignal>
 #include <cstdlib>
-#include <format>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
 
+#include "battery.h"
 #include "clock.h"
+#include "command_channel.h"
+#include "drone_rules.h"
+#include "drone_state.h"
+#include "event_loop.h"
 #include "logger.h"
 #include "thread.h"
 #include "thread_utils.h"
+#include "zygote.h"
 
 using namespace std::chrono_literals;
 
@@ -19,154 +33,462 @@ auto HandleExpectedError(const auto& expected) {
 }
 
 inline auto GetLogger() -> Logger& {
-    static auto g_logger = Logger::Create("drone");
+    static auto g_logger = []() {
+        auto logger = Logger::Create("drone");
+        if (logger) {
+            logger->EnableBatching({.max_records = 16, .max_delay = 1s});
+            // a full log queue must not stall the control loop
+            logger->SetOverflowPolicy(Logger::OverflowPolicy::SPILL);
+            logger->SetRateLimit(LogFormatId::BATTERY_LEVEL,
+                                 {.per_second = 1,
+                                  .burst = 5,
+                                  .sample_every = 1,
+                                  .report_every = 10s});
+        }
+        return logger;
+    }();
     if (!HandleExpectedError(g_logger)) {
         _Exit(1);
     }
     return *g_logger;
 }
 
-constexpr auto g_ignore_suicide_bat_thr = 20;
-constexpr auto g_low_bat_thr = 20;
-constexpr auto g_max_charges = 2;
+// how often the event loop runtime looks for commands
+constexpr auto g_command_poll_interval = 250ms;
 
-}  // namespace
+auto HasFlag(std::span<char*> args, std::string_view flag) -> bool {
+    return std::ranges::any_of(
+        args, [&](const char* arg) { return std::string_view(arg) == flag; });
+}
+
+// Value of e.g. --slot, the swarm state table slot, none when not given.
+auto ParseOption(std::span<char*> args, std::string_view option)
+    -> std::optional<size_t> {
+    for (auto arg = args.begin(); arg != args.end(); ++arg) {
+        if (std::string_view(*arg) == option &&
+            std::next(arg) != args.end()) {
+            return std::strtoull(*std::next(arg), nullptr, 10);
+        }
+    }
+    return std::nullopt;
+}
+
+auto AttachSwarm() -> std::optional<SwarmState> {
+    auto attached = SwarmState::Get();
+    if (!attached) {
+        return std::nullopt;
+    }
+    return std::move(*attached);
+}
+
+// The drone's state machine, shared by both runtimes. Not synchronised,
+// the threaded runtime holds its mutex around every call.
+class Drone {
+  public:
+    Drone(std::optional<size_t> slot, std::optional<SwarmState> swarm)
+        : slot_(slot),
+          swarm_(std::move(swarm)),
+          battery_(g_initial_bat_level, g_bat_step, MonotonicClock::now()) {
+        if (slot_ && swarm_ && *slot_ < (*swarm_)->Capacity()) {
+            (*swarm_)->Claim(*slot_, getpid());
+        } else {
+            if (slot_) {
+                GetLogger().Warning("Swarm state slot unavailable");
+            }
+            swarm_.reset();
+        }
+        Publish();
+
+        GetLogger().Debug("Hello world");
+    }
+    Drone(Drone&&) = delete;
+    Drone(const Drone&) = delete;
+    auto operator=(Drone&&) -> Drone& = delete;
+    auto operator=(const Drone&) -> Drone& = delete;
+    ~Drone() {
+        if (swarm_) {
+            (*swarm_)->Release(*slot_);
+        }
+        GetLogger().Info("Goodbye");
+    }
+
+    // Acts on everything due by `now` and returns when to be called again:
+    // the next battery level acted on or logged, or the end of a flight to
+    // or from the base. None when only an order can change anything.
+    auto Step(MonotonicClock::time_point now)
+        -> std::optional<MonotonicClock::time_point> {
+        while (!done_ && Advance(now)) {
+        }
+        if (done_) {
+            return std::nullopt;
+        }
+
+        const int level = battery_.Level(now);
+        // the next multiple of 10 is logged, it covers 0 and 100
+        const int next_logged = battery_.Charging()
+                                    ? (level / 10 + 1) * 10
+                                    : (level - 1) / 10 * 10;
+        auto deadline = battery_.ReachesAt(next_logged, now);
+        const auto sooner = [&](std::optional<MonotonicClock::time_point> at) {
+            if (at && (!deadline || *at < *deadline)) {
+                deadline = at;
+            }
+        };
+        if (phase_ == Phase::FLYING) {
+            sooner(battery_.ReachesAt(g_low_bat_thr - 1, now));
+        }
+        if (phase_ == Phase::RETURNING || phase_ == Phase::LEAVING) {
+            sooner(phase_end_);
+        }
+        return deadline;
+    }
+
+    [[nodiscard]] auto Done() const -> bool {
+        return done_;
+    }
 
-auto main(int /*argc*/, char* /*argv*/[]) -> int {
+    // Returns whether the order was accepted, Step acts on it.
+    auto OrderSuicide(std::optional<int64_t> order_id) -> bool {
+        const bool accepted = AcceptsSuicideOrder(Level());
+        if (order_id) {
+            GetLogger().Info(accepted ? LogFormatId::SUICIDE_ORDER_ACCEPTED
+                                      : LogFormatId::SUICIDE_ORDER_IGNORED,
+                             *order_id);
+        } else {
+            GetLogger().Info(accepted ? "Suicide mission order accepted"
+                                      : "Suicide mission order ignored");
+        }
+        if (!accepted) {
+            return false;
+        }
+        suicide_order_received_ = true;
+        Publish();
+        return true;
+    }
+
+  private:
+    enum class Phase : uint8_t { FLYING, RETURNING, DOCKED, LEAVING };
+
+    [[nodiscard]] auto Level() const -> int {
+        return battery_.Level(MonotonicClock::now());
+    }
+
+    void Publish() {
+        if (!swarm_) {
+            return;
+        }
+        (*swarm_)->SetBatteryLevel(*slot_, Level());
+        (*swarm_)->SetCharges(*slot_, charges_);
+        (*swarm_)->SetDocked(*slot_, docked_);
+        (*swarm_)->SetSuicideOrder(*slot_, suicide_order_received_);
+    }
+
+    // Makes at most one transition, returns whether it did.
+    auto Advance(MonotonicClock::time_point now) -> bool {
+        const int level = battery_.Level(now);
+        if (level != last_level_) {
+            if (level % 10 == 0) {
+                GetLogger().Info(LogFormatId::BATTERY_LEVEL, level);
+            }
+            last_level_ = level;
+            Publish();
+        }
+        if (level <= Battery::min_level_) {
+            GetLogger().Warning("Battery died!");
+            done_ = true;
+            return false;
+        }
+
+        switch (phase_) {
+            case Phase::FLYING:
+                if (!ShouldReturn(level, suicide_order_received_)) {
+                    return false;
+                }
+                GetLogger().Info("Returning to the base");
+                phase_ = Phase::RETURNING;
+                phase_end_ = now + g_base_flight_time;  // TODO: go to base
+                return true;
+            case Phase::RETURNING:
+                if (now < phase_end_) {
+                    return false;
+                }
+                GetLogger().Info("Back at the base");
+                if (ShouldDecommission(charges_)) {
+                    GetLogger().Info("Max charging cycles, decomissioning");
+                    done_ = true;
+                    return false;
+                }
+                phase_ = Phase::DOCKED;
+                docked_ = true;
+                battery_.SetCharging(true, now);
+                Publish();
+                return true;
+            case Phase::DOCKED:
+                if (!ShouldLeave(level, suicide_order_received_)) {
+                    return false;
+                }
+                GetLogger().Info("Leaving the base");
+                phase_ = Phase::LEAVING;
+                phase_end_ = now + g_base_flight_time;  // TODO: leave base
+                charges_++;
+                Publish();
+                return true;
+            case Phase::LEAVING:
+                if (now < phase_end_) {
+                    return false;
+                }
+                GetLogger().Info("Left the base");
+                phase_ = Phase::FLYING;
+                docked_ = false;
+                battery_.SetCharging(false, now);
+                Publish();
+                return true;
+        }
+        return false;
+    }
+
+    std::optional<size_t> slot_;
+    std::optional<SwarmState> swarm_;
+    Battery battery_;
+    int charges_ = 0;
+    bool docked_ = false;
+    bool suicide_order_received_ = false;
+
+    Phase phase_ = Phase::FLYING;
+    MonotonicClock::time_point phase_end_;
+    int last_level_ = g_initial_bat_level;
+    bool done_ = false;
+};
+
+// SIGUSR1 is the plain order, the real-time one carries an order id
+auto OrderSignals() -> sigset_t {
     sigset_t sigset;
     sigemptyset(&sigset);
     sigaddset(&sigset, SIGUSR1);
+    sigaddset(&sigset, CommandSignal(CommandType::SUICIDE));
+    return sigset;
+}
+
+auto OrderId(int signal, int code, int value) -> std::optional<int64_t> {
+    if (signal != SIGUSR1 && code == SI_QUEUE) {
+        return value;
+    }
+    return std::nullopt;
+}
+
+auto CommandStatusFor(bool accepted) -> CommandStatus {
+    return accepted ? CommandStatus::ACCEPTED : CommandStatus::REJECTED;
+}
+
+// The runtime's threads can only be cancelled while they block in here,
+// never while they hold the state mutex or are halfway through logging.
+auto Cancellable(auto&& blocking) {
+    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, nullptr);
+    auto result = blocking();
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, nullptr);
+    return result;
+}
+
+// A thread each for signals and commands, the control loop on the main one.
+auto RunThreaded(std::optional<size_t> slot, std::optional<SwarmState> swarm)
+    -> int {
+    const sigset_t sigset = OrderSignals();
     pthread_sigmask(SIG_BLOCK, &sigset, nullptr);
+    // termination is handled by the signal thread alone, so it is the one
+    // interrupted and can wake the others
+    sigset_t termset;
+    sigemptyset(&termset);
+    sigaddset(&termset, SIGTERM);
+    sigaddset(&termset, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &termset, nullptr);
 
     ThreadMutex state_mut;
     ThreadCond state_changed;
-    int bat_level = 50;
-    int charges = 0;
-    bool docked = false;
+    Drone drone(slot, std::move(swarm));
+    // orders through the command channel are acknowledged, signals can't be
+    auto commands = CommandChannel::Get();
 
-    bool suicide_order_received = false;
-
-    GetLogger().Debug("Hello world");
-
-    const auto should_return = [&]() {
-        return !docked && bat_level < g_low_bat_thr && !suicide_order_received;
-    };
-    const auto should_leave = [&]() {
-        return docked && (bat_level == 100 || suicide_order_received);
+    // the threads use the locals above, they are stopped before returning
+    std::vector<Thread> threads;
+    const auto stop_threads = [&]() {
+        for (const auto& thread : threads) {
+            auto cancelled = thread.Cancel();
+            auto joined = thread.Join();
+        }
     };
 
     const auto signal_thread = Thread::Create([&]() {
+        pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, nullptr);
+        pthread_sigmask(SIG_UNBLOCK, &termset, nullptr);
         while (true) {
-            int sig{};
-            sigwait(&sigset, &sig);
-
-            state_mut.Lock();
-            if (bat_level < g_ignore_suicide_bat_thr) {
-                GetLogger().Info("Suicide mission order ignored");
-                state_mut.Unlock();
+            siginfo_t info{};
+            if (Cancellable([&]() { return sigwaitinfo(&sigset, &info); }) ==
+                -1) {
+                // EINTR, the SIGTERM handler ran in this thread
+                if (CurrentProcess::TerminateReceived()) {
+                    state_mut.Lock();
+                    state_changed.Broadcast();
+                    state_mut.Unlock();
+                }
                 continue;
             }
-            suicide_order_received = true;
-            GetLogger().Info("Suicide mission order accepted");
+
+            state_mut.Lock();
+            drone.OrderSuicide(OrderId(info.si_signo, info.si_code,
+                                       info.si_value.sival_int));
             state_changed.Broadcast();
             state_mut.Unlock();
         }
     });
-    if (!signal_thread) {
+    if (!HandleExpectedError(signal_thread)) {
         return 1;
     }
+    threads.push_back(*signal_thread);
 
-    const auto battery_thread = Thread::Create([&]() {
-        auto next = MonotonicClock::now();
-        const auto dur = 50ms;
-
-        while (!CurrentProcess::TerminateReceived()) {
-            next += dur;
-            auto slept = Thread::SleepUntil(next);
-            if (!slept) {
-                GetLogger().Info("Sleep interruped");
-                CurrentProcess::Get().Signal(SIGTERM).value();
-                return;
-            }
-
-            state_mut.Lock();
-            if (docked) {
-                bat_level++;
-            } else {
-                bat_level--;
-            }
-            auto clamped = std::clamp(bat_level, 0, 100);
-            if (bat_level == clamped && clamped % 10 == 0) {
-                GetLogger().Info(std::format("Bat: {:>3}%", clamped));
-            }
-            bat_level = clamped;
-
-            if (bat_level <= 0) {
-                GetLogger().Warning("Battery died!");
-                CurrentProcess::Get().Signal(SIGTERM).value();
-                state_changed.Broadcast();
-                state_mut.Unlock();
-                return;
+    if (commands) {
+        const auto command_thread = Thread::Create([&]() {
+            pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, nullptr);
+            while (auto command = Cancellable(
+                       [&]() { return commands->ReceiveCommand(); })) {
+                auto status = CommandStatus::UNKNOWN;
+                if (command->type == CommandType::SUICIDE) {
+                    state_mut.Lock();
+                    status = CommandStatusFor(drone.OrderSuicide(command->id));
+                    state_changed.Broadcast();
+                    state_mut.Unlock();
+                }
+                if (!commands->Acknowledge(*command, status)) {
+                    GetLogger().Warning("Acknowledging a command failed");
+                }
             }
-
-            if (should_return() || should_leave() ||
-                CurrentProcess::TerminateReceived()) {
-                state_changed.Broadcast();
-            }
-
-            state_mut.Unlock();
+        });
+        if (!HandleExpectedError(command_thread)) {
+            stop_threads();
+            return 1;
         }
-    });
-    if (!HandleExpectedError(battery_thread)) {
-        return 1;
+        threads.push_back(*command_thread);
     }
 
     state_mut.Lock();
-    while (bat_level > 0 && !CurrentProcess::TerminateReceived()) {
-        state_changed.Wait(state_mut);
-        if (bat_level <= 0 || CurrentProcess::TerminateReceived()) {
+    while (!CurrentProcess::TerminateReceived()) {
+        const auto deadline = drone.Step(MonotonicClock::now());
+        if (drone.Done()) {
             break;
         }
+        if (deadline) {
+            state_changed.WaitUntil(state_mut, *deadline);
+        } else {
+            state_changed.Wait(state_mut);
+        }
+    }
+    state_mut.Unlock();
 
-        if (should_leave()) {
-            charges++;
-            state_mut.Unlock();
+    stop_threads();
+    return 0;
+}
+
+// Everything on one thread: signals through a signalfd, the next deadline
+// on a timerfd. SysV message queues can't be polled, so the command channel
+// is drained on a slow timer and after every wake-up instead.
+auto RunEventLoop(std::optional<size_t> slot, std::optional<SwarmState> swarm)
+    -> int {
+    auto loop = EventLoop::Create();
+    if (!HandleExpectedError(loop)) {
+        return 1;
+    }
+    Drone drone(slot, std::move(swarm));
+    auto commands = CommandChannel::Get();
 
-            GetLogger().Info("Leaving the base");
-            if (!Thread::SleepFor(500ms)) {  // TODO: leave base
-                break;
+    std::optional<EventLoop::TimerId> step_timer;
+    const auto step = [&]() {
+        if (commands) {
+            while (auto command = commands->ReceiveCommand(false)) {
+                auto status = CommandStatus::UNKNOWN;
+                if (command->type == CommandType::SUICIDE) {
+                    status = CommandStatusFor(drone.OrderSuicide(command->id));
+                }
+                if (!commands->Acknowledge(*command, status)) {
+                    GetLogger().Warning("Acknowledging a command failed");
+                }
             }
+        }
 
-            state_mut.Lock();
-            docked = false;
-            GetLogger().Info("Left the base");
-            continue;
+        const auto deadline = drone.Step(MonotonicClock::now());
+        if (drone.Done()) {
+            loop->Stop();
+            return;
         }
-        if (should_return()) {
-            state_mut.Unlock();
+        if (!HandleExpectedError(loop->SetTimer(*step_timer, deadline))) {
+            loop->Stop();
+        }
+    };
 
-            GetLogger().Info("Returning to the base");
-            if (!Thread::SleepFor(500ms)) {  // TODO: go to base
-                break;
-            }
+    auto timer = loop->AddTimer(step);
+    if (!HandleExpectedError(timer)) {
+        return 1;
+    }
+    step_timer = *timer;
 
-            state_mut.Lock();
-            GetLogger().Info("Back at the base");
-            if (charges == g_max_charges) {
-                GetLogger().Info("Max charging cycles, decomissioning");
-                CurrentProcess::Get().Signal(SIGTERM).value();
-                break;
+    sigset_t signals = OrderSignals();
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGINT);
+    auto watched =
+        loop->WatchSignals(signals, [&](const signalfd_siginfo& info) {
+            const auto signal = static_cast<int>(info.ssi_signo);
+            if (signal == SIGTERM || signal == SIGINT) {
+                loop->Stop();
+                return;
             }
-            docked = true;
-            continue;
+            drone.OrderSuicide(OrderId(signal, info.ssi_code, info.ssi_int));
+            step();
+        });
+    if (!HandleExpectedError(watched)) {
+        return 1;
+    }
+
+    if (commands) {
+        auto poll_timer = loop->AddTimer(step);
+        if (!HandleExpectedError(poll_timer) ||
+            !HandleExpectedError(loop->SetTimer(
+                *poll_timer, MonotonicClock::now() + g_command_poll_interval,
+                g_command_poll_interval))) {
+            return 1;
         }
     }
-    state_mut.Unlock();
 
-    if (!HandleExpectedError(battery_thread->Join())) {
+    step();
+    if (!HandleExpectedError(loop->Run())) {
         return 1;
     }
-    GetLogger().Info("Goodbye");
-
     return 0;
 }
+
+auto RunDrone(bool event_loop, std::optional<size_t> slot,
+              std::optional<SwarmState> swarm) -> int {
+    return event_loop ? RunEventLoop(slot, std::move(swarm))
+                      : RunThreaded(slot, std::move(swarm));
+}
+
+}  // namespace
+
+auto main(int argc, char* argv[]) -> int {
+    const auto args = std::span(argv, static_cast<size_t>(argc));
+    // a single thread per drone instead of three
+    const bool event_loop = HasFlag(args, "--event-loop");
+    if (HasFlag(args, "--zygote")) {
+        // attached and created once here, every forked drone inherits the
+        // mappings and only picks its own log queue shard
+        auto swarm = AttachSwarm();
+        GetLogger();
+        const std::function<int(size_t)> run_drone = [&](size_t slot) {
+            if (!HandleExpectedError(GetLogger().ResetAfterFork())) {
+                return 1;
+            }
+            return RunDrone(event_loop, slot, std::move(swarm));
+        };
+        return RunZygote(ParseOption(args, "--pool").value_or(0), run_drone);
+    }
+
+    const auto slot = ParseOption(args, "--slot");
+    return RunDrone(event_loop, slot, slot ? AttachSwarm() : std::nullopt);
+}
@@ -0,0 +1,207 @@
+#include "zygote.h"
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <optional>
+#include <vector>
+
+#include "drone_zygote.h"
+#include "logger.h"
+#include "process.h"
+
+namespace {
+// fork(2), except the child ends up the operator's: a middle child forks
+// it and exits, and the orphan goes to the operator, a child subreaper.
+// Both are plain fork() calls, so glibc sets up the drone's thread state
+// (cached tid, robust futex list) and runs the atfork handlers as usual.
+// The middle child is reaped before returning, the drone is reparented by
+// then.
+auto ForkSibling() -> pid_t {
+    std::array<int, 2> result{};
+    if (pipe2(result.data(), O_CLOEXEC) == -1) {
+        return -1;
+    }
+
+    const auto middle = fork();
+    if (middle == -1) {
+        close(result[0]);
+        close(result[1]);
+        return -1;
+    }
+    if (middle == 0) {
+        close(result[0]);
+        const auto drone = fork();
+        if (drone != 0) {
+            const pid_t reply = drone == -1 ? -errno : drone;
+            auto written = write(result[1], &reply, sizeof(reply));
+            (void)written;  // a short read tells the zygote it failed
+            _exit(0);
+        }
+        close(result[1]);
+        return 0;
+    }
+
+    close(result[1]);
+    pid_t drone = -ECHILD;
+    while (read(result[0], &drone, sizeof(drone)) == -1 && errno == EINTR) {
+    }
+    close(result[0]);
+    while (waitpid(middle, nullptr, 0) == -1 && errno == EINTR) {
+    }
+
+    if (drone < 0) {
+        errno = -drone;
+        return -1;
+    }
+    return drone;
+}
+
+class Zygote {
+  public:
+    Zygote(size_t pool_size, const std::function<int(size_t)>& run_drone)
+        : pool_size_(pool_size), run_drone_(run_drone) {
+        pool_.reserve(pool_size);
+    }
+    Zygote(Zygote&&) = delete;
+    Zygote(const Zygote&) = delete;
+    auto operator=(Zygote&&) -> Zygote& = delete;
+    auto operator=(const Zygote&) -> Zygote& = delete;
+    ~Zygote() {
+        // parked drones exit when their launch pipe closes
+        for (const auto& parked : pool_) {
+            close(parked.launch_fd);
+        }
+    }
+
+    auto Serve() -> int {
+        while (!CurrentProcess::TerminateReceived()) {
+            while (pool_.size() < pool_size_) {
+                if (!Park()) {
+                    LogPrinter::PrintError("zygote", "Couldn't park a drone");
+                    break;
+                }
+            }
+
+            ZygoteRequest request{};
+            const auto got = read(g_zygote_fd, &request, sizeof(request));
+            if (got == -1 && errno == EINTR) {
+                continue;
+            }
+            if (got != sizeof(request)) {
+                break;  // the operator is gone
+            }
+
+            // a parked drone is woken only after the reply, it would
+            // otherwise compete with the zygote for the CPU and delay it
+            std::optional<Parked> parked;
+            if (!pool_.empty()) {
+                parked = pool_.back();
+                pool_.pop_back();
+            }
+            const ZygoteReply reply{
+                .result = parked ? parked->pid : Fork(request.slot)};
+            const auto replied = write(g_zygote_fd, &reply, sizeof(reply));
+            if (parked) {
+                Wake(*parked, request.slot);
+            }
+            if (replied != sizeof(reply)) {
+                break;
+            }
+        }
+        return 0;
+    }
+
+  private:
+    struct Parked {
+        pid_t pid;
+        int launch_fd;
+    };
+
+    // Returns the drone's pid or -errno.
+    auto Fork(size_t slot) -> pid_t {
+        const auto drone = ForkSibling();
+        if (drone == 0) {
+            BecomeDrone(slot);
+        }
+        return drone == -1 ? -errno : drone;
+    }
+
+    // A parked drone that died meanwhile is reported to the operator as an
+    // exited child, like any other.
+    static void Wake(const Parked& parked, size_t slot) {
+        const ZygoteRequest request{.slot = slot};
+        if (write(parked.launch_fd, &request, sizeof(request)) !=
+            sizeof(request)) {
+            LogPrinter::PrintError("zygote", "Parked drone is gone");
+        }
+        close(parked.launch_fd);
+    }
+
+    // Forks a drone that waits for its slot on a pipe of its own.
+    auto Park() -> bool {
+        std::array<int, 2> launch{};
+        if (pipe2(launch.data(), O_CLOEXEC) == -1) {
+            return false;
+        }
+
+        const auto drone = ForkSibling();
+        if (drone == -1) {
+            close(launch[0]);
+            close(launch[1]);
+            return false;
+        }
+        if (drone == 0) {
+            close(launch[1]);
+            ZygoteRequest request{};
+            if (read(launch[0], &request, sizeof(request)) !=
+                sizeof(request)) {
+                _exit(0);  // never launched
+            }
+            close(launch[0]);
+            BecomeDrone(request.slot);
+        }
+
+        close(launch[0]);
+        pool_.push_back({.pid = drone, .launch_fd = launch[1]});
+        return true;
+    }
+
+    // Runs in the forked child.
+    [[noreturn]] void BecomeDrone(size_t slot) {
+        close(g_zygote_fd);
+        for (const auto& parked : pool_) {
+            close(parked.launch_fd);
+        }
+        pool_.clear();
+        std::signal(SIGPIPE, SIG_DFL);
+        CurrentProcess::ResetAfterFork();
+
+        // exit, not _exit, the drone's logger flushes in its destructor
+        std::exit(run_drone_(slot));
+    }
+
+    size_t pool_size_;
+    const std::function<int(size_t)>& run_drone_;
+    std::vector<Parked> pool_;
+};
+}  // namespace
+
+auto RunZygote(size_t pool_size, const std::function<int(size_t)>& run_drone)
+    -> int {
+    // a parked drone that died must not take the zygote with it
+    std::signal(SIGPIPE, SIG_IGN);
+    // the zygote leads the swarm's process group, so the operator can stop
+    // all drones with one kill
+    if (setpgid(0, 0) == -1) {
+        LogPrinter::PrintError("zygote", "Couldn't start a process group");
+    }
+
+    Zygote zygote(pool_size, run_drone);
+    return zygote.Serve();
+}
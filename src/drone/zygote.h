@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+// Serves DroneZygote requests on g_zygote_fd until the operator closes it
+// or SIGTERM arrives. Must be called while the process has a single thread.
+// `run_drone` runs in every forked drone with its slot and returns the
+// drone's exit status.
+auto RunZygote(size_t pool_size, const std::function<int(size_t)>& run_drone)
+    -> int;
@@ -0,0 +1,84 @@
+#include <cstdlib>
+#include <iostream>
+#include <optional>
+#include <span>
+#include <string_view>
+
+#include "ipc/shared_memory.h"
+#include "log_levels.h"
+#include "logger.h"
+
+namespace {
+auto ParseLevel(std::string_view name) -> std::optional<Logger::LogLevel> {
+    if (name == "debug") {
+        return Logger::DEBUG;
+    }
+    if (name == "info") {
+        return Logger::INFO;
+    }
+    if (name == "warn") {
+        return Logger::WARNING;
+    }
+    if (name == "error") {
+        return Logger::ERROR;
+    }
+    return std::nullopt;
+}
+
+void PrintUsage() {
+    std::cerr << "usage: logctl [--run <id>] <args>\n"
+                 "       logctl <level>            set the global level\n"
+                 "       logctl <sender> <level>   override one sender\n"
+                 "       logctl <sender> default   drop the override\n"
+                 "levels: debug, info, warn, error\n"
+                 "--run picks the simulation run, DRONE_SWARM_RUN otherwise\n";
+}
+}  // namespace
+
+auto main(int argc, char* argv[]) -> int {
+    auto args = std::span(argv, static_cast<size_t>(argc)).subspan(1);
+    if (args.size() >= 2 && std::string_view(args.front()) == "--run") {
+        auto run_id = IpcRun::Parse(args[1]);
+        if (!run_id) {
+            LogPrinter::PrintError("logctl", run_id.error().what());
+            return 2;
+        }
+        if (auto set = IpcRun::SetId(*run_id); !set) {
+            LogPrinter::PrintError("logctl", set.error().what());
+            return 2;
+        }
+        args = args.subspan(2);
+    }
+    if (args.empty() || args.size() > 2) {
+        PrintUsage();
+        return 2;
+    }
+
+    auto levels = SharedMemory<LogLevels>::Get(SharedMemoryKey::LOG_LEVELS);
+    if (!levels) {
+        LogPrinter::PrintError("logctl", levels.error().what());
+        return 1;
+    }
+
+    const std::string_view level_name = args.back();
+    if (args.size() == 2 && level_name == "default") {
+        (*levels)->ClearOverride(args.front());
+        return 0;
+    }
+
+    const auto level = ParseLevel(level_name);
+    if (!level) {
+        PrintUsage();
+        return 2;
+    }
+
+    if (args.size() == 1) {
+        (*levels)->SetMinLevel(*level);
+        return 0;
+    }
+    if (!(*levels)->SetOverride(args.front(), *level)) {
+        LogPrinter::PrintError("logctl", "No free override slots");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,33 @@
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <string_view>
+
+#include "logger.h"
+
+auto main(int argc, char* argv[]) -> int {
+    const auto args = std::span(argv, static_cast<size_t>(argc));
+    if (args.size() != 2) {
+        std::cerr << "usage: logdecode <binary log>\n";
+        return 2;
+    }
+
+    const std::unique_ptr<std::FILE, int (*)(std::FILE*)> input{
+        std::fopen(args[1], "rb"), fclose};
+    if (!input) {
+        LogPrinter::PrintError("logdecode",
+                               std::system_error(errno, std::generic_category(),
+                                                 args[1])
+                                   .what());
+        return 1;
+    }
+
+    auto decoded = LogPrinter::DecodeBinaryLog(input.get(), std::cout);
+    if (!decoded) {
+        LogPrinter::PrintError("logdecode", decoded.error().what());
+        return 1;
+    }
+
+    return 0;
+}
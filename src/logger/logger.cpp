@@ -4,9 +4,15 @@
 #include <fcntl.h>
 #include <unistd.h>
 
+#include <chrono>
 #include <cstdio>
+#include <cstdlib>
 #include <experimental/scope>
+#include <iterator>
+#include <span>
+#include <string_view>
 
+#include "ipc/ipc_registry.h"
 #include "process.h"
 
 namespace {
@@ -18,8 +24,34 @@ auto HandleExpectedError(const auto& expected) {
 }
 }  // namespace
 
-auto main(int /*argc*/, char* /*argv*/[]) -> int {
-    auto log_receiver = LogPrinter::Create();
+auto main(int argc, char* argv[]) -> int {
+    LogPrinterConfig config;
+    const auto args = std::span(argv, static_cast<size_t>(argc)).subspan(1);
+    for (auto arg = args.begin(); arg != args.end(); ++arg) {
+        const std::string_view name = *arg;
+        if (name == "--ring-buffer") {
+            config.transport = LogTransport::RING_BUFFER;
+        } else if (name == "--binary" && std::next(arg) != args.end()) {
+            config.binary_path = *++arg;
+        } else if (name == "--report" && std::next(arg) != args.end()) {
+            config.report_path = *++arg;
+        } else if (name == "--rotate-size" && std::next(arg) != args.end()) {
+            config.rotate_size = std::strtoull(*++arg, nullptr, 10);
+        } else if (name == "--shards" && std::next(arg) != args.end()) {
+            config.queue_shards = std::strtoull(*++arg, nullptr, 10);
+        } else if (name == "--reorder-window" &&
+                   std::next(arg) != args.end()) {
+            config.reorder_window =
+                std::chrono::milliseconds(std::strtoll(*++arg, nullptr, 10));
+        }
+    }
+
+    // a logger started on its own may find its crashed predecessor's queues
+    if (!HandleExpectedError(IpcRegistry::ReclaimStale())) {
+        return 1;
+    }
+
+    auto log_receiver = LogPrinter::Create(config);
     if (!HandleExpectedError(log_receiver)) {
         return 1;
     }
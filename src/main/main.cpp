@@ -1,9 +1,25 @@
 #include <unistd.h>
 
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <csignal>
+#include <cstdlib>
+#include <format>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
 
+#include "command_channel.h"
+#include "drone_rules.h"
+#include "drone_state.h"
+#include "drone_zygote.h"
+#include "ipc/ipc_registry.h"
 #include "logger.h"
 #include "process.h"
+#include "supervisor.h"
 #include "thread.h"
 
 namespace {
@@ -13,19 +29,144 @@ auto Err(auto&& val) -> decltype(auto) {
     }
     return std::forward<decltype(val)>(val).value();
 }
+
+// swarm state table size, drones may double after the first signal
+constexpr size_t g_max_drones = 2;
+// how long drones get to exit after SIGTERM before SIGKILL
+constexpr auto g_shutdown_grace = std::chrono::seconds(2);
+// how often acks are collected while orders are unanswered
+constexpr auto g_ack_poll_interval = std::chrono::milliseconds(100);
+
+void LogAcks(Logger& logger, std::vector<CommandAck>& acks) {
+    for (const auto& ack : acks) {
+        logger.Info(ack.status == CommandStatus::ACCEPTED
+                        ? LogFormatId::ORDER_ACCEPTED_BY
+                        : LogFormatId::ORDER_REFUSED_BY,
+                    ack.drone, ack.id);
+    }
+    acks.clear();
+}
 }  // namespace
 
-auto main(int /*argc*/, char* /*argv*/[]) -> int {
+auto main(int argc, char* argv[]) -> int {
     using namespace std::chrono_literals;
     try {
-        auto logger_process = Err(Process::CreateReady({"./logger"}));
+        // --run-id picks the IPC key range, otherwise an inherited one is
+        // kept and a standalone run uses its pid, which no other live run
+        // can have. --event-loop runs drones on a single thread each.
+        // --report defaults to a file per run, so runs sharing a directory
+        // don't overwrite each other's report. --suicide-after S orders
+        // every drone alive S seconds in on a suicide mission.
+        const auto args = std::span(argv, static_cast<size_t>(argc));
+        std::optional<uint32_t> run_id;
+        std::optional<std::string> report;
+        std::optional<std::chrono::seconds> suicide_after;
+        bool event_loop = false;
+        for (size_t i = 1; i < args.size(); ++i) {
+            const std::string_view arg = args[i];
+            const bool has_value = i + 1 < args.size();
+            if (arg == "--run-id" && has_value) {
+                run_id = Err(IpcRun::Parse(args[++i]));
+            } else if (arg == "--report" && has_value) {
+                report = args[++i];
+            } else if (arg == "--suicide-after" && has_value) {
+                suicide_after = std::chrono::seconds(
+                    std::strtoull(args[++i], nullptr, 10));
+            } else if (arg == "--event-loop") {
+                event_loop = true;
+            }
+        }
+        if (run_id) {
+            Err(IpcRun::SetId(*run_id));
+        } else if (std::getenv(IpcRun::env_var_) == nullptr) {
+            Err(IpcRun::SetId(static_cast<uint32_t>(getpid())));
+        }
+        if (!report) {
+            report = std::format("simulation-{}.log", IpcRun::Id());
+        }
+
+        // objects left over by crashed runs would make Create fail
+        Err(IpcRegistry::ReclaimStale());
+
+        auto logger_process = Err(
+            Process::CreateReady({"./logger", "--report", report->c_str()}));
+
+        auto logger = Err(Logger::Create("main"));
+
+        auto swarm = Err(SwarmState::Create(g_max_drones, 0666));
+        auto commands = Err(CommandChannel::Create(0666));
 
-        // const auto& logger = Err(Logger::Create("main"));
+        // replenishment forks from the zygote's warm pool instead of
+        // starting the drone binary every time
+        auto zygote = Err(DroneZygote::Create(g_max_drones, event_loop));
+        auto supervisor = Err(Supervisor::Create());
+        // a SIGTERM right before Poll blocks must still end the loop
+        Err(supervisor.StopOn({SIGTERM, SIGINT}));
+        const auto on_exit = [&](const ChildExit& exit) {
+            if (exit.reason == ChildExit::Reason::KILLED) {
+                logger.Info(LogFormatId::DRONE_KILLED, exit.pid, exit.code);
+            } else {
+                logger.Info(LogFormatId::DRONE_EXITED, exit.pid, exit.code);
+            }
+            // the pid is not reaped yet, nobody else can have taken it
+            if (auto discarded = commands.Discard(exit.pid); !discarded) {
+                LogPrinter::PrintError("main", discarded.error().what());
+            }
+        };
+        Err(supervisor.Watch(Err(zygote.Launch(0)), on_exit));
 
-        auto drone_process = Err(Process::Create({"./drone"}));
+        bool order_pending = suicide_after.has_value();
+        const auto order_at =
+            MonotonicClock::now() +
+            suicide_after.value_or(std::chrono::seconds::zero());
+        std::vector<CommandAck> acks;
+        size_t unanswered = 0;
+        while (supervisor.Size() > 0 && !CurrentProcess::TerminateReceived()) {
+            std::optional<std::chrono::milliseconds> timeout;
+            if (unanswered > 0) {
+                timeout = g_ack_poll_interval;
+            } else if (order_pending) {
+                timeout = std::max(
+                    std::chrono::ceil<std::chrono::milliseconds>(
+                        order_at - MonotonicClock::now()),
+                    std::chrono::milliseconds::zero());
+            }
+            Err(supervisor.Poll(timeout));
 
-        Err(drone_process.Wait());
-        auto slept = Thread::SleepFor(1s);
+            if (order_pending && MonotonicClock::now() >= order_at) {
+                // picked from the state table, drones that would refuse
+                // the order for their battery are left alone
+                std::array<uint32_t, g_max_drones> slots{};
+                const auto found =
+                    swarm->SuicideCandidates(g_ignore_suicide_bat_thr, slots);
+                std::vector<pid_t> drones;
+                for (const auto slot : std::span(slots).first(found)) {
+                    if (const auto pid = swarm->Pid(slot); pid != 0) {
+                        drones.push_back(pid);
+                    }
+                }
+                Err(commands.SendAll(drones, CommandType::SUICIDE, 0, acks));
+                logger.Info(LogFormatId::SUICIDE_ORDERS_SENT, drones.size());
+                unanswered += drones.size();
+                order_pending = false;
+            }
+            while (unanswered > acks.size()) {
+                auto ack = commands.ReceiveAck(false);
+                if (!ack) {
+                    if (ack.error().code() != std::errc::no_message) {
+                        Err(ack);
+                    }
+                    break;
+                }
+                acks.push_back(*ack);
+            }
+            // drones that died without answering don't count
+            unanswered -= std::min(unanswered, acks.size());
+            unanswered = std::min(unanswered, supervisor.Size());
+            LogAcks(logger, acks);
+        }
+        Err(supervisor.Shutdown(g_shutdown_grace));
+        Err(zygote.Stop());
         Err(logger_process.TermWait());
     } catch (std::exception& e) {
         LogPrinter::PrintError("main", e.what());
@@ -0,0 +1,121 @@
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "drone_rules.h"
+#include "ipc/ipc_registry.h"
+#include "logger.h"
+#include "process.h"
+#include "swarm.h"
+#include "thread.h"
+
+namespace {
+auto Err(auto&& val) -> decltype(auto) {
+    if (!val) {
+        throw std::forward<decltype(val)>(val).error();
+    }
+    return std::forward<decltype(val)>(val).value();
+}
+
+constexpr size_t g_default_drones = 100'000;
+constexpr auto g_steps_per_second = std::chrono::seconds(1) / g_bat_step;
+
+void LogSummary(Logger& logger, const Swarm& swarm, int64_t second) {
+    using enum Swarm::Phase;
+    const auto counts = swarm.CountPhases();
+    const auto count = [&](Swarm::Phase phase) {
+        return static_cast<int64_t>(counts.at(static_cast<size_t>(phase)));
+    };
+    logger.Info(LogFormatId::SWARM_SUMMARY, second,
+                count(FLYING) + count(RETURNING),
+                count(DOCKED) + count(LEAVING),
+                count(DIED) + count(DECOMMISSIONED));
+}
+}  // namespace
+
+// Simulates a swarm in one process, every drone an entity of Swarm instead
+// of a process, with the same rules and logging through the same logger.
+// Runs as fast as it can, --realtime paces it like the process-based mode.
+// The report goes to --report, swarm_engine-<run id>.log by default.
+auto main(int argc, char* argv[]) -> int {
+    try {
+        const auto args = std::span(argv, static_cast<size_t>(argc));
+        size_t drones = g_default_drones;
+        std::optional<int64_t> max_seconds;
+        std::optional<uint32_t> run_id;
+        std::optional<std::string> report;
+        bool realtime = false;
+        for (size_t i = 1; i < args.size(); ++i) {
+            const std::string_view arg = args[i];
+            const bool has_value = i + 1 < args.size();
+            if (arg == "--drones" && has_value) {
+                drones = std::strtoull(args[++i], nullptr, 10);
+            } else if (arg == "--seconds" && has_value) {
+                max_seconds = std::strtoll(args[++i], nullptr, 10);
+            } else if (arg == "--run-id" && has_value) {
+                run_id = Err(IpcRun::Parse(args[++i]));
+            } else if (arg == "--report" && has_value) {
+                report = args[++i];
+            } else if (arg == "--realtime") {
+                realtime = true;
+            }
+        }
+        if (run_id) {
+            Err(IpcRun::SetId(*run_id));
+        } else if (std::getenv(IpcRun::env_var_) == nullptr) {
+            Err(IpcRun::SetId(static_cast<uint32_t>(getpid())));
+        }
+        if (!report) {
+            report = std::format("swarm_engine-{}.log", IpcRun::Id());
+        }
+
+        Err(IpcRegistry::ReclaimStale());
+
+        auto logger_process = Err(
+            Process::CreateReady({"./logger", "--report", report->c_str()}));
+        auto logger = Err(Logger::Create("engine"));
+
+        Swarm swarm(drones);
+        const auto started = MonotonicClock::now();
+        auto next_step = started;
+        int64_t steps = 0;
+        while (swarm.Active() > 0 && !CurrentProcess::TerminateReceived()) {
+            if (max_seconds && steps >= *max_seconds * g_steps_per_second) {
+                break;
+            }
+            swarm.Step();
+            ++steps;
+            if (steps % g_steps_per_second == 0) {
+                LogSummary(logger, swarm, steps / g_steps_per_second);
+            }
+            if (realtime) {
+                next_step += g_bat_step;
+                if (!Thread::SleepUntil(next_step)) {
+                    break;
+                }
+            }
+        }
+
+        using std::chrono::duration_cast, std::chrono::milliseconds;
+        const auto elapsed =
+            duration_cast<milliseconds>(MonotonicClock::now() - started);
+        const auto counts = swarm.CountPhases();
+        logger.Info(
+            LogFormatId::SWARM_DONE, static_cast<int64_t>(drones),
+            steps / g_steps_per_second, elapsed.count(),
+            static_cast<int64_t>(counts.at(
+                static_cast<size_t>(Swarm::Phase::DECOMMISSIONED))));
+
+        Err(logger_process.TermWait());
+    } catch (std::exception& e) {
+        LogPrinter::PrintError("swarm_engine", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,112 @@
+#include "swarm.h"
+
+#include <algorithm>
+
+#include "drone_rules.h"
+
+namespace {
+constexpr auto g_leg_steps =
+    static_cast<uint8_t>(g_base_flight_time / g_bat_step);
+}  // namespace
+
+Swarm::Swarm(size_t size)
+    : bat_level_(size, static_cast<int8_t>(g_initial_bat_level)),
+      bat_delta_(size, -1),
+      phase_(size, Phase::FLYING),
+      leg_steps_(size, 0),
+      charges_(size, 0),
+      suicide_order_(size, 0),
+      active_(size) {}
+
+void Swarm::Step() {
+    const auto size = Size();
+
+    for (size_t i = 0; i < size; ++i) {
+        const int level = bat_level_[i] + bat_delta_[i];
+        bat_level_[i] =
+            static_cast<int8_t>(std::clamp(level, 0, g_full_bat_level));
+    }
+    for (size_t i = 0; i < size; ++i) {
+        leg_steps_[i] -= static_cast<uint8_t>(leg_steps_[i] != 0);
+    }
+
+    for (size_t i = 0; i < size; ++i) {
+        while (Advance(i)) {
+        }
+    }
+}
+
+auto Swarm::OrderSuicide(size_t drone) -> bool {
+    const auto phase = phase_[drone];
+    if (phase == Phase::DIED || phase == Phase::DECOMMISSIONED ||
+        !AcceptsSuicideOrder(bat_level_[drone])) {
+        return false;
+    }
+    suicide_order_[drone] = 1;
+    return true;
+}
+
+auto Swarm::CountPhases() const -> PhaseCounts {
+    PhaseCounts counts{};
+    for (const auto phase : phase_) {
+        ++counts.at(static_cast<size_t>(phase));
+    }
+    return counts;
+}
+
+auto Swarm::Advance(size_t drone) -> bool {
+    auto& phase = phase_[drone];
+    if (phase == Phase::DIED || phase == Phase::DECOMMISSIONED) {
+        return false;
+    }
+    const int level = bat_level_[drone];
+    const bool suicide_order = suicide_order_[drone] != 0;
+    if (level <= 0) {
+        Retire(drone, Phase::DIED);
+        return false;
+    }
+
+    switch (phase) {
+        case Phase::FLYING:
+            if (!ShouldReturn(level, suicide_order)) {
+                return false;
+            }
+            phase = Phase::RETURNING;
+            leg_steps_[drone] = g_leg_steps;
+            return true;
+        case Phase::RETURNING:
+            if (leg_steps_[drone] != 0) {
+                return false;
+            }
+            if (ShouldDecommission(charges_[drone])) {
+                Retire(drone, Phase::DECOMMISSIONED);
+                return false;
+            }
+            phase = Phase::DOCKED;
+            bat_delta_[drone] = 1;
+            return true;
+        case Phase::DOCKED:
+            if (!ShouldLeave(level, suicide_order)) {
+                return false;
+            }
+            phase = Phase::LEAVING;
+            leg_steps_[drone] = g_leg_steps;
+            ++charges_[drone];
+            return true;
+        case Phase::LEAVING:
+            if (leg_steps_[drone] != 0) {
+                return false;
+            }
+            phase = Phase::FLYING;
+            bat_delta_[drone] = -1;
+            return true;
+        default:
+            return false;
+    }
+}
+
+void Swarm::Retire(size_t drone, Phase phase) {
+    phase_[drone] = phase;
+    bat_delta_[drone] = 0;
+    --active_;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Every drone of a swarm as an entity, its state split into one column per
+// field, simulated in steps of g_bat_step with the rules of drone_rules.h.
+// A step is a few passes over whole columns. The battery and flight leg
+// passes are branch-free and vectorise, only drones that act take a branch
+// in the transition pass.
+class Swarm {
+  public:
+    // NOLINTNEXTLINE(performance-enum-size)
+    enum class Phase : uint8_t {
+        FLYING,
+        RETURNING,
+        DOCKED,
+        LEAVING,
+        DIED,
+        DECOMMISSIONED,
+        COUNT
+    };
+    using PhaseCounts = std::array<size_t, static_cast<size_t>(Phase::COUNT)>;
+
+    explicit Swarm(size_t size);
+
+    // Advances every drone by one battery step.
+    void Step();
+
+    // Returns whether the order was accepted, like a drone process does.
+    auto OrderSuicide(size_t drone) -> bool;
+
+    [[nodiscard]] auto Size() const -> size_t {
+        return phase_.size();
+    }
+    // Drones that neither died nor were decommissioned.
+    [[nodiscard]] auto Active() const -> size_t {
+        return active_;
+    }
+    [[nodiscard]] auto CountPhases() const -> PhaseCounts;
+
+  private:
+    // Makes at most one transition, returns whether it did.
+    auto Advance(size_t drone) -> bool;
+    void Retire(size_t drone, Phase phase);
+
+    std::vector<int8_t> bat_level_;
+    // +1 charging, -1 draining, 0 once retired
+    std::vector<int8_t> bat_delta_;
+    std::vector<Phase> phase_;
+    // steps left of the flight to or from the base
+    std::vector<uint8_t> leg_steps_;
+    std::vector<uint8_t> charges_;
+    std::vector<uint8_t> suicide_order_;
+    size_t active_;
+};